@@ -19,6 +19,7 @@
 #include "modules/data/WorldData.hpp"                       // global data that my game modules use
 #include "modules/engine/pattern/Receiver.hpp"              // class that receives signals and processes data
 #include "modules/engine/pattern/Signal.hpp"                // signal that emits data
+#include "modules/engine/main/TransformBenchmark.hpp"       // per-object matrices microbenchmark
 #include "modules/data/SignalTypes.hpp"                     // signal types
 
 // MAIN APP
@@ -28,6 +29,7 @@ class App : public BaseProject {
 protected:
 
     // Descriptor Layouts ["classes" of what will be passed to the shaders]
+    DescriptorSetLayout globalDSL;
     DescriptorSetLayout DSL;
 
     // Vertex formats
@@ -62,11 +64,7 @@ protected:
         windowTitle = "Rainbow Stadium: Time Attack!";
         windowResizable = GLFW_TRUE;
         initialBackgroundColor = {0.01f, 0.01f, 0.08f, 1.0f}; // dark blue
-        
-        // Descriptor pool sizes
-        uniformBlocksInPool = 766;
-        texturesInPool = 387;
-        setsInPool = 387;
+
 
         EngineAspectRatio = 4.0f / 3.0f;
     }
@@ -83,12 +81,15 @@ protected:
         // Initialize ENGINE parameters
         EngineBaseProject = this;
         EngineWindow = window;
+        EngineRandomSeed = inputReplay.getSeed();
         
-        // Descriptor Set Layout
+        // Descriptor Set Layouts: set 0 = global uniforms (shared by all the draws), set 1 = instance group
+        globalDSL.init(this, {
+            {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS}
+        });
         DSL.init(this, {
-            {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS},
-            {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT},
-            {2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS}
+            {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT},
+            {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT}
         });
         
         // Vertex descriptors
@@ -112,6 +113,14 @@ protected:
         mainScene.load("models/scene.json", &vertexDescriptor);
         mainScene.init();
         
+        // Descriptor pool sizes (per swap chain image): the global set with its uniform buffer, one set per
+        // instance group with its instance storage buffer and texture, and the UI sets with their font textures
+        int groupCount = (int)instanceGroups.size();
+        uniformBlocksInPool = 1;
+        storageBlocksInPool = groupCount;
+        texturesInPool = groupCount + UIManager::DESCRIPTOR_SETS;
+        setsInPool = 1 + groupCount + UIManager::DESCRIPTOR_SETS;
+        
         // init audio data from config file's path
         json config = parseConfigFile();
         audioData = config["audio"];
@@ -150,7 +159,7 @@ protected:
             });
         }
         
-        std::vector<Signal*> uiManagerSignals = { &speedSignal, &timeSignal, &coinsSignal, &lapsSignal, &scoreSignal };
+        std::vector<Signal*> uiManagerSignals = { &speedSignal, &timeSignal, &coinsSignal, &lapsSignal, &scoreSignal, &statsOverlaySignal };
         for (Signal* signal : uiManagerSignals) {
             signal->addListener([this, signal](std::string id, std::any data) {
                 this->uiManager.onSignal(signal->getId(), data);
@@ -175,30 +184,26 @@ protected:
             this->carManager.onSignal(countdownSignal.getId(), data);
         });
         
-        rebuildPipelineSignal.addListener([this](std::string id, std::any data) {
-            this->RebuildPipeline();
-        });
-        
         std::cout << "Initialization completed!\n";
     }
     
     void initPhongPipeline(){
         // Pipeline [Shader couples]
-        phongPipeline.init(this, &vertexDescriptor, "shaders/phong/PhongVert.spv", "shaders/phong/PhongFrag.spv", { &DSL });
+        phongPipeline.init(this, &vertexDescriptor, "shaders/phong/PhongVert.spv", "shaders/phong/PhongFrag.spv", { &globalDSL, &DSL });
         phongPipeline.setAdvancedFeatures(VK_COMPARE_OP_LESS_OR_EQUAL, VK_POLYGON_MODE_FILL,
             VK_CULL_MODE_NONE, false);
     }
     
     void initCookTorrancePipeline(){
         // Pipeline [Shader couples]
-        cookTorrancePipeline.init(this, &vertexDescriptor, "shaders/cook_torrance/CookTorranceVert.spv", "shaders/cook_torrance/CookTorranceFrag.spv", { &DSL });
+        cookTorrancePipeline.init(this, &vertexDescriptor, "shaders/cook_torrance/CookTorranceVert.spv", "shaders/cook_torrance/CookTorranceFrag.spv", { &globalDSL, &DSL });
         cookTorrancePipeline.setAdvancedFeatures(VK_COMPARE_OP_LESS_OR_EQUAL, VK_POLYGON_MODE_FILL,
             VK_CULL_MODE_NONE, false);
     }
     
     void initToonPipeline(){
         // Pipeline [Shader couples]
-        toonPipeline.init(this, &vertexDescriptor, "shaders/toon/ToonVert.spv", "shaders/toon/ToonFrag.spv", { &DSL });
+        toonPipeline.init(this, &vertexDescriptor, "shaders/toon/ToonVert.spv", "shaders/toon/ToonFrag.spv", { &globalDSL, &DSL });
         toonPipeline.setAdvancedFeatures(VK_COMPARE_OP_LESS_OR_EQUAL, VK_POLYGON_MODE_FILL,
             VK_CULL_MODE_NONE, false);
     }
@@ -211,7 +216,7 @@ protected:
         toonPipeline.create();
 
         // Here you define the data set
-        mainScene.descriptorSetsInit(&DSL);
+        mainScene.descriptorSetsInit(&globalDSL, &DSL);
         uiManager.pipelinesAndDescriptorSetsInit();
     }
 
@@ -235,7 +240,8 @@ protected:
     // methods: .cleanup() recreates them, while .destroy() delete them completely
     void localCleanup() {
         std::cout << "Starting local cleanup.\n";
-        // Cleanup descriptor set layout
+        // Cleanup descriptor set layouts
+        globalDSL.cleanup();
         DSL.cleanup();
         
         std::cout << "DSL cleanup completed.\n";
@@ -263,16 +269,33 @@ protected:
     // with their buffers and textures
 
     void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage) {
-        // binds the pipeline
-        phongPipeline.bind(commandBuffer);
-        cookTorrancePipeline.bind(commandBuffer);
-        toonPipeline.bind(commandBuffer);
-        
-        mainScene.populateCommandBuffer(commandBuffer, currentImage, {
+        // the scene binds each pipeline before drawing its objects
+        mainScene.populateCommandBuffer(commandBuffer, currentImage, scenePipelines(), &gpuTimer);
+        uiManager.populateOverlayCommandBuffer(commandBuffer, currentImage);
+    }
+    
+    const std::vector<VkCommandBuffer>& populateCommandBufferParallel(ParallelRecorder& recorder, int currentImage) {
+        return mainScene.populateCommandBufferParallel(recorder, currentImage, scenePipelines(), &gpuTimer,
+            [this, currentImage](VkCommandBuffer commandBuffer) {
+                uiManager.populateOverlayCommandBuffer(commandBuffer, currentImage);
+            });
+    }
+    
+    void buildRecordingBenchmarkScene(size_t objects) {
+        mainScene.buildRecordingBenchmarkQueue(objects);
+    }
+    
+    // indexed by PipelineType, as the scene times its pipeline groups
+    std::vector<std::string> gpuTimerGroups() {
+        return {"phong", "cook-torrance", "toon"};
+    }
+    
+    std::unordered_map<PipelineType, Pipeline*> scenePipelines() {
+        return {
             {PHONG, &phongPipeline},
             {COOK_TORRANCE, &cookTorrancePipeline},
             {TOON, &toonPipeline}
-        });
+        };
     }
     
     void populateDynamicCommandBuffer(VkCommandBuffer commandBuffer, int currentImage) {
@@ -291,26 +314,146 @@ protected:
         // gets WASD and arrows input from user and sets deltaT
         getSixAxis(EngineDeltaTime, carMovementInput, cameraRotationInput);
 
-        carManager.update();
-        physicsManager.update();
+        timedUpdate("car", carManager);
+        timedUpdate("physics", physicsManager);
         
         vehicleTextureWorldMatrix = getCarTextureWorldMatrix(carWorldData);
         
-        sceneManager.update();
-        lightsManager.update();
-        inputManager.update();
-        cameraManager.update();
-        gameManager.update();
-        uiManager.update();
-        audioManager.update();
-        drawManager.update();
+        timedUpdate("scene", sceneManager);
+        timedUpdate("lights", lightsManager);
+        timedUpdate("input", inputManager);
+        timedUpdate("camera", cameraManager);
+        timedUpdate("game", gameManager);
+        timedUpdate("ui", uiManager);
+        timedUpdate("audio", audioManager);
+        timedUpdate("draw", drawManager);
+    }
+    
+    // updates a manager, timing it for the report while an input recording is replayed
+    // and marking it for the profiler (the name must be a literal)
+    void timedUpdate(const char* name, Manager& manager) {
+        PROFILE_SCOPE(name);
+        if (!inputReplay.isTiming()) {
+            manager.update();
+            return;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        manager.update();
+        inputReplay.addTime(name, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
     }
     
 };
 
 // This is the main: probably you do not need to touch this!
-int main() {
+// WARNING: changed by us - command line options:
+//   --soak [seconds]              soak test (see SoakTest.hpp)
+//   --record-threads [n]          records the scene on n worker threads (all the cores if n is omitted)
+//   --record-every-frame          records the scene every frame instead of once per swap chain image
+//   --record-benchmark [objects]  times the scene recording against the thread count, then quits
+//   --no-pipeline-cache           builds every pipeline from scratch (to compare creation times)
+//   --headless [frames]           renders frames (300 if omitted, 0 until a replay ends) offscreen, without a window, then quits
+//   --resolution WxH              size of the headless frames (800x600 if omitted)
+//   --dump-frame n                saves headless frame n as headless_frame_<n>.png (can be repeated)
+//   --record-input file           records the input of every frame (see InputReplay.hpp)
+//   --replay file                 plays a recorded input back with a fixed timestep, then quits
+//   --replay-timestep seconds     timestep of the replay (1/60 if omitted, 0 uses the recorded ones)
+//   --replay-report file          where the replay writes its timings (replay_report.json if omitted)
+//   --profile [file]              records the profiler markers, written as a Chrome trace at exit and
+//                                 when P is pressed (profile_trace.json if omitted)
+//   --transform-benchmark         times the per-object matrices against TransformBatch, then quits
+int main(int argc, char* argv[]) {
     App app;
+    
+    // option values never start with '-': a value left out is reported instead of taking the next option
+    auto valueAfter = [&](int& i) -> std::string {
+        if (i + 1 >= argc || argv[i + 1][0] == '-') {
+            throw std::invalid_argument("Missing value for " + std::string(argv[i]));
+        }
+        return argv[++i];
+    };
+    auto toNumber = [](const std::string& option, const std::string& text) {
+        char* end = nullptr;
+        double value = std::strtod(text.c_str(), &end);
+        if (text.empty() || *end != '\0' || !std::isfinite(value) || value < 0.0) {
+            throw std::invalid_argument("Invalid value for " + option + ": " + text);
+        }
+        return value;
+    };
+    auto toCount = [](const std::string& option, const std::string& text) {
+        char* end = nullptr;
+        unsigned long value = std::strtoul(text.c_str(), &end, 10);
+        if (text.empty() || !std::isdigit((unsigned char)text[0]) || *end != '\0' || value > UINT32_MAX) {
+            throw std::invalid_argument("Invalid value for " + option + ": " + text);
+        }
+        return (uint32_t)value;
+    };
+    // optional values: the fallback when the next argument is not a number
+    auto numberAfter = [&](int& i, double fallback) {
+        std::string option = argv[i];
+        return (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) ? toNumber(option, argv[++i]) : fallback;
+    };
+    auto countAfter = [&](int& i, uint32_t fallback) {
+        std::string option = argv[i];
+        return (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) ? toCount(option, argv[++i]) : fallback;
+    };
+    bool headless = false;
+    uint32_t headlessFrames = 300, headlessWidth = 800, headlessHeight = 600;
+    std::string replayPath, replayReport = "replay_report.json";
+    double replayTimestep = INPUT_REPLAY_DEFAULT_TIMESTEP;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string option = argv[i];
+            if (option == "--soak") {
+                app.enableSoakTest(numberAfter(i, 0.0));
+            } else if (option == "--record-threads") {
+                app.enableParallelRecording(countAfter(i, 0));
+            } else if (option == "--record-every-frame") {
+                app.enableSceneRecordingEveryFrame();
+            } else if (option == "--record-benchmark") {
+                app.enableRecordingBenchmark(countAfter(i, 10000));
+            } else if (option == "--no-pipeline-cache") {
+                app.disablePipelineCache();
+            } else if (option == "--headless") {
+                headless = true;
+                headlessFrames = countAfter(i, headlessFrames);
+            } else if (option == "--resolution") {
+                std::string value = valueAfter(i);
+                char trailing;
+                if (std::sscanf(value.c_str(), "%ux%u%c", &headlessWidth, &headlessHeight, &trailing) != 2 ||
+                    headlessWidth == 0 || headlessHeight == 0) {
+                    throw std::invalid_argument("Invalid resolution: " + value + " (expected WxH)");
+                }
+            } else if (option == "--dump-frame") {
+                app.dumpHeadlessFrame(toCount(option, valueAfter(i)));
+            } else if (option == "--record-input") {
+                app.enableInputRecording(valueAfter(i));
+            } else if (option == "--replay") {
+                replayPath = valueAfter(i);
+            } else if (option == "--replay-timestep") {
+                replayTimestep = toNumber(option, valueAfter(i));
+            } else if (option == "--replay-report") {
+                replayReport = valueAfter(i);
+            } else if (option == "--profile") {
+                bool hasFile = i + 1 < argc && argv[i + 1][0] != '-';
+                app.enableProfiler(hasFile ? argv[++i] : "profile_trace.json");
+            } else if (option == "--transform-benchmark") {
+                runTransformBenchmark();
+                return EXIT_SUCCESS;
+            } else {
+                throw std::invalid_argument("Unknown option: " + option);
+            }
+        }
+    }
+    catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (headless) {
+        app.enableHeadless(headlessFrames, headlessWidth, headlessHeight);
+    }
+    if (!replayPath.empty()) {
+        app.enableInputReplay(replayPath, replayTimestep, replayReport);
+    }
 
     try {
         app.run();
@@ -319,6 +462,9 @@ int main() {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
+    if (app.soakTestFailed()) {
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -17,5 +17,7 @@ float EngineAspectRatio = 4.0f/3.0f;
 
 // SIMULATION DATA
 float EngineDeltaTime = 60;
+// seed of the scene's random numbers: recorded with the input, so that a replay builds the same scene
+uint32_t EngineRandomSeed = 0;
 
 #endif
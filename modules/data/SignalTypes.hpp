@@ -9,11 +9,11 @@ const std::string COUNTDOWN_SIGNAL = "COUNTDOWN";
 const std::string HEADLIGHTS_CHANGE_SIGNAL = "HEADLIGHTS_CHANGE";
 const std::string LAPS_SIGNAL = "LAPS";
 const std::string QUIT_SIGNAL = "QUIT";
-const std::string REBUILD_PIPELINE_SIGNAL = "REBUILD_PIPELINE";
 const std::string RESET_VIEW_SIGNAL = "RESET_VIEW";
 const std::string REVERSE_SIGNAL = "REVERSE";
 const std::string SCORE_SIGNAL = "SCORE";
 const std::string SPEED_SIGNAL = "SPEED";
+const std::string STATS_OVERLAY_SIGNAL = "STATS_OVERLAY";
 const std::string TIME_SIGNAL = "TIME_SIGNAL";
 const std::string UPDATE_DEBOUNCE_SIGNAL = "UPDATE_DEBOUNCE";
 const std::string UPDATE_NEXT_CHECKPOINT_SIGNAL = "UPDATE_NEXT_CHECKPOINT";
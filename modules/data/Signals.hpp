@@ -12,11 +12,11 @@ Signal countdownSignal = Signal(COUNTDOWN_SIGNAL);
 Signal headlightsChangeSignal = Signal(HEADLIGHTS_CHANGE_SIGNAL);
 Signal lapsSignal = Signal(LAPS_SIGNAL);
 Signal quitSignal = Signal(QUIT_SIGNAL);
-Signal rebuildPipelineSignal = Signal(REBUILD_PIPELINE_SIGNAL);
 Signal resetViewSignal = Signal(RESET_VIEW_SIGNAL);
 Signal reverseSignal = Signal(REVERSE_SIGNAL);
 Signal scoreSignal = Signal(SCORE_SIGNAL);
 Signal speedSignal = Signal(SPEED_SIGNAL);
+Signal statsOverlaySignal = Signal(STATS_OVERLAY_SIGNAL);
 Signal timeSignal = Signal(TIME_SIGNAL);
 Signal updateDebounceSignal = Signal(UPDATE_DEBOUNCE_SIGNAL);
 Signal updateNextCheckpointSignal = Signal(UPDATE_NEXT_CHECKPOINT_SIGNAL);
@@ -2,6 +2,7 @@
 #define WORLD_DATA_HPP
 
 #include "../modules/engine/main/GameObject.hpp"
+#include "../modules/engine/main/graphics/InstanceGroup.hpp"
 
 /*
  "World Data" is game data that frequently changes (e.g., due to user actions).
@@ -26,6 +27,8 @@ glm::vec3 cameraRotationInput = ZERO_VEC3;
 
 // SCENE DATA
 std::vector<GameObject*> gameObjects;
+std::vector<InstanceGroup*> instanceGroups;
+DescriptorSet globalDescriptorSet; // set 0 of the scene pipelines: the GlobalUniformBufferObject
 CameraWorldData cameraWorldData;
 CarWorldData carWorldData;
 glm::mat4 vehicleTextureWorldMatrix;
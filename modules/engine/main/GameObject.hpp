@@ -11,52 +11,40 @@ public:
     std::string getId() const { return id; }
     Model* getModel() const { return model; }
     Texture* getTexture() const { return texture; }
-    DescriptorSet* getDescriptorSet() const { return descriptorSet; }
     PipelineType getPipelineType() const { return pipelineType; }
     float getProperty(std::string key) { return properties[key]; }
     bool isEnabled() const { return enabled; }
     
-    glm::mat4 worldMatrix;
+    // every change of the transform goes through setWorldMatrix and bumps its version: the draw manager
+    // uploads an object's instance data again only when its version moved (see InstanceGroup::isUploaded)
+    const glm::mat4& getWorldMatrix() const { return worldMatrix; }
+    uint64_t getTransformVersion() const { return transformVersion; }
+    
+    void setWorldMatrix(const glm::mat4& wm) {
+        worldMatrix = wm;
+        transformVersion++;
+    }
+    
+    // inverse transpose of the world matrix, recomputed only after the transform changed
+    const glm::mat4& getNormalMatrix() {
+        if (normalMatrixVersion != transformVersion) {
+            normalMatrix = glm::inverse(glm::transpose(worldMatrix));
+            normalMatrixVersion = transformVersion;
+        }
+        return normalMatrix;
+    }
     
-    GameObject(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props)
-    : id(id), model(m), texture(t), worldMatrix(wm), descriptorSet(ds), pipelineType(pt), properties(props) {
+    GameObject(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props)
+    : id(id), model(m), texture(t), pipelineType(pt), properties(props), worldMatrix(wm) {
         enabled = true;
-        _oldWorldMatrix = worldMatrix;
     };
     
     virtual void init() {};
     
-    void descriptorSetInit(DescriptorSetLayout* dsl){
-        switch(pipelineType){
-            case COOK_TORRANCE:
-                descriptorSet->init(EngineBaseProject, dsl, {
-                    {0, UNIFORM, sizeof(CookTorranceUniformBufferObject), nullptr},
-                    {1, TEXTURE, 0, texture},
-                    {2, UNIFORM, sizeof(GlobalUniformBufferObject), nullptr}
-                });
-                break;
-            case PHONG:
-                descriptorSet->init(EngineBaseProject, dsl, {
-                    {0, UNIFORM, sizeof(PhongUniformBufferObject), nullptr},
-                    {1, TEXTURE, 0, texture},
-                    {2, UNIFORM, sizeof(GlobalUniformBufferObject), nullptr}
-                });
-                break;
-            case TOON:
-                descriptorSet->init(EngineBaseProject, dsl, {
-                    {0, UNIFORM, sizeof(ToonUniformBufferObject), nullptr},
-                    {1, TEXTURE, 0, texture},
-                    {2, UNIFORM, sizeof(GlobalUniformBufferObject), nullptr}
-                });
-                break;
-        }
-    }
-    
     virtual void update() {};
     
-    void descriptorSetCleanup() {
-        descriptorSet->cleanup();
-    }
+    // objects that never move are not updated every frame (see DrawManager)
+    virtual bool isStatic() const { return false; }
     
     void localCleanup() {
         texture->cleanup();
@@ -65,37 +53,12 @@ public:
     
     virtual ~GameObject() = default;
     
-    void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage, Pipeline* pipeline) {
-        model->bind(commandBuffer);
-        descriptorSet->bind(commandBuffer, *pipeline, 0, currentImage);
-                    
-        vkCmdDrawIndexed(commandBuffer,
-                static_cast<uint32_t>(model->indices.size()), 1, 0, 0, 0);
-    }
-    
-    void mapMemoryCookTorrance(int currentImage, GlobalUniformBufferObject* gubo, CookTorranceUniformBufferObject* ubo){
-        descriptorSet->map(currentImage, ubo, sizeof(*ubo), 0);
-        descriptorSet->map(currentImage, gubo, sizeof(*gubo), 2);
-    }
-    
-    void mapMemoryPhong(int currentImage, GlobalUniformBufferObject* gubo, PhongUniformBufferObject* ubo){
-        descriptorSet->map(currentImage, ubo, sizeof(*ubo), 0);
-        descriptorSet->map(currentImage, gubo, sizeof(*gubo), 2);
-    }
-    
-    void mapMemoryToon(int currentImage, GlobalUniformBufferObject* gubo, ToonUniformBufferObject* ubo){
-        descriptorSet->map(currentImage, ubo, sizeof(*ubo), 0);
-        descriptorSet->map(currentImage, gubo, sizeof(*gubo), 2);
-    }
-    
+    // disabled objects are left out of the per-frame draw list (see DrawManager)
     void disable(){
-        _oldWorldMatrix = worldMatrix;
-        worldMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.0f));
         enabled = false;
     }
     
     void enable(){
-        worldMatrix = _oldWorldMatrix;
         enabled = true;
     }
     
@@ -104,14 +67,18 @@ protected:
     std::string id;
     Model* model;
     Texture* texture;
-    DescriptorSet* descriptorSet;
     PipelineType pipelineType;
     std::unordered_map<std::string, float> properties;
     
     bool enabled;
     
-    // world matrix before the object is disabled
-    glm::mat4 _oldWorldMatrix;
+private:
+    
+    glm::mat4 worldMatrix;
+    uint64_t transformVersion = 0;
+    
+    glm::mat4 normalMatrix;
+    uint64_t normalMatrixVersion = ~0ull;
     
 };
 
@@ -0,0 +1,268 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ Scoped CPU profiler: PROFILE_SCOPE("name") times the rest of the enclosing block.
+ Every thread writes its scopes into its own ring buffer (one complete event per scope: name, start,
+ duration, nesting depth), so recording takes no lock and never allocates; the oldest events are
+ overwritten when a ring is full. The only lock is taken once per thread, when it records its first
+ event and gets a ring (rings of finished threads are reused, the pools are short-lived; a reused ring
+ starts a new track and the events of the finished thread are dropped).
+ Profiler::dumpChromeTrace writes every ring as Chrome trace JSON (chrome://tracing, Perfetto),
+ one track per thread, with the nesting shown by the time containment of the scopes. It can run while
+ the threads record: every slot carries a sequence number (a per-slot seqlock), and the slots being
+ written or overwritten while they are copied are skipped.
+
+ Names must outlive the profiler (string literals): only the pointer is stored.
+ Disabled at runtime a scope costs one relaxed atomic load; built with DISABLE_PROFILER the macros
+ expand to nothing.
+ */
+
+const size_t PROFILER_EVENTS_PER_THREAD = 1 << 15;
+
+struct ProfilerEvent {
+    const char* name;
+    int64_t startNs;        // since Profiler::epoch
+    int64_t durationNs;
+    uint32_t depth;
+};
+
+// one event of a ring: sequence is 2 * index + 1 while the event of that index is written, 2 * index + 2
+// once it is complete; the fields are relaxed atomics so that a concurrent copy is a race on nothing
+struct ProfilerSlot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> startNs{0};
+    std::atomic<int64_t> durationNs{0};
+    std::atomic<uint32_t> depth{0};
+};
+
+// single producer (the owning thread), read by dumpChromeTrace
+struct ProfilerRing {
+    std::unique_ptr<ProfilerSlot[]> slots{new ProfilerSlot[PROFILER_EVENTS_PER_THREAD]};
+    std::atomic<uint64_t> head{0};      // events written so far
+    uint64_t first = 0;                 // first event of the current track (under Profiler::ringsMutex)
+    uint32_t threadId = 0;
+    std::string threadName;
+    uint32_t depth = 0;                 // open scopes of the owning thread
+    bool inUse = true;
+    bool isTrack = false;               // see Profiler::track
+};
+
+// the ring of the calling thread, handed back when the thread exits
+struct ProfilerThreadRing {
+    ProfilerRing* ring = nullptr;
+    const char* name = "thread";
+    ~ProfilerThreadRing();
+};
+
+class Profiler {
+
+    friend struct ProfilerThreadRing;
+
+    inline static std::atomic<bool> enabled{false};
+    inline static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    inline static std::mutex ringsMutex;
+    inline static std::vector<std::unique_ptr<ProfilerRing>> rings;
+    inline static uint32_t nextThreadId = 1;
+
+    inline static thread_local ProfilerThreadRing threadRing;
+
+    static ProfilerRing* acquireRing() {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        ProfilerRing* ring = nullptr;
+        for (std::unique_ptr<ProfilerRing>& r : rings) {
+            if (!r->inUse) {
+                ring = r.get();
+                break;
+            }
+        }
+        if (ring == nullptr) {
+            rings.push_back(std::make_unique<ProfilerRing>());
+            ring = rings.back().get();
+        }
+        // a new track: the events a finished thread left in a reused ring are not part of it. The head
+        // keeps counting, so that the slot sequences never repeat and a reader cannot mistake an old event
+        // for a new one
+        ring->first = ring->head.load(std::memory_order_relaxed);
+        ring->inUse = true;
+        ring->depth = 0;
+        ring->threadId = nextThreadId++;
+        ring->threadName = threadRing.name;
+        threadRing.ring = ring;
+        return ring;
+    }
+
+    static void writeEscaped(std::ofstream& out, const std::string& text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+    }
+
+public:
+
+    static void enable(bool on = true) {
+        enabled.store(on, std::memory_order_relaxed);
+    }
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // label of the calling thread's track in the trace
+    static void setThreadName(const char* name) {
+        threadRing.name = name;
+        if (threadRing.ring != nullptr) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            threadRing.ring->threadName = name;
+        }
+    }
+
+    static ProfilerRing& ring() {
+        ProfilerRing* ring = threadRing.ring;
+        return ring != nullptr ? *ring : *acquireRing();
+    }
+
+    // a track that is not a thread's (e.g. the GPU timings), for one writer at a time; never reused
+    static ProfilerRing& track(const char* name) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (std::unique_ptr<ProfilerRing>& r : rings) {
+            if (r->isTrack && r->threadName == name) return *r;
+        }
+        rings.push_back(std::make_unique<ProfilerRing>());
+        ProfilerRing* ring = rings.back().get();
+        ring->isTrack = true;
+        ring->threadId = nextThreadId++;
+        ring->threadName = name;
+        return *ring;
+    }
+
+    static void record(ProfilerRing& ring, const char* name, int64_t startNs, int64_t endNs, uint32_t depth) {
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        ProfilerSlot& slot = ring.slots[head % PROFILER_EVENTS_PER_THREAD];
+        slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.startNs.store(startNs, std::memory_order_relaxed);
+        slot.durationNs.store(endNs - startNs, std::memory_order_relaxed);
+        slot.depth.store(depth, std::memory_order_relaxed);
+        slot.sequence.store(2 * head + 2, std::memory_order_release);
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    // copies the event of the given index, false if the slot holds another one or is being written
+    static bool readEvent(const ProfilerRing& ring, uint64_t index, ProfilerEvent& event) {
+        const ProfilerSlot& slot = ring.slots[index % PROFILER_EVENTS_PER_THREAD];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) return false;
+        event = {slot.name.load(std::memory_order_relaxed), slot.startNs.load(std::memory_order_relaxed),
+                 slot.durationNs.load(std::memory_order_relaxed), slot.depth.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    // best called between frames: an event overwritten while it is copied is dropped, not torn
+    static bool dumpChromeTrace(const std::string& path) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "Profiler: cannot write " << path << std::endl;
+            return false;
+        }
+
+        size_t eventCount = 0;
+        std::vector<ProfilerEvent> events;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const std::unique_ptr<ProfilerRing>& ring : rings) {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t begin = head > PROFILER_EVENTS_PER_THREAD ? head - PROFILER_EVENTS_PER_THREAD : 0;
+            begin = std::max(begin, ring->first);
+            events.clear();
+            ProfilerEvent event;
+            for (uint64_t i = begin; i < head; i++) {
+                if (readEvent(*ring, i, event)) events.push_back(event);
+            }
+
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId
+                << ",\"args\":{\"name\":\"";
+            writeEscaped(out, ring->threadName);
+            out << "\"}}";
+            first = false;
+
+            for (const ProfilerEvent& e : events) {
+                out << ",\n{\"name\":\"";
+                writeEscaped(out, e.name);
+                out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->threadId << ",\"ts\":" << e.startNs / 1000.0
+                    << ",\"dur\":" << e.durationNs / 1000.0 << ",\"args\":{\"depth\":" << e.depth << "}}";
+                eventCount++;
+            }
+        }
+        out << "\n]}\n";
+        std::cout << "Profiler: " << eventCount << " events written to " << path << "\n";
+        return true;
+    }
+};
+
+inline ProfilerThreadRing::~ProfilerThreadRing() {
+    if (ring == nullptr) return;
+    std::lock_guard<std::mutex> lock(Profiler::ringsMutex);
+    ring->inUse = false;
+}
+
+// times the enclosing scope, nested in the scopes already open on the same thread
+class ProfileScope {
+
+    const char* name;
+    ProfilerRing* ring = nullptr;
+    int64_t startNs = 0;
+    uint32_t depth = 0;
+
+public:
+
+    explicit ProfileScope(const char* scopeName) : name(scopeName) {
+        if (!Profiler::isEnabled()) return;
+        ring = &Profiler::ring();
+        depth = ring->depth++;
+        startNs = Profiler::now();
+    }
+
+    ~ProfileScope() {
+        if (ring == nullptr) return;
+        Profiler::record(*ring, name, startNs, Profiler::now(), depth);
+        ring->depth--;
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef DISABLE_PROFILER
+#define PROFILE_SCOPE(name)
+#define PROFILE_THREAD_NAME(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+#endif
+
+#endif
@@ -1,12 +1,32 @@
 #ifndef SCENE_HPP
 #define SCENE_HPP
 
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <tuple>
+
 #include "tools/Types.hpp"
 #include "engine/main/GameObject.hpp"
+#include "engine/main/ThreadPool.hpp"
 #include "../modules/data/WorldData.hpp"
 
+// Timing of a single asset in Scene::load
+struct AssetLoadTiming {
+    std::string name;
+    std::string kind;
+    double decodeMs = 0.0;
+    double uploadMs = 0.0;
+};
+
 class Scene {
 protected:
+    
+    RenderStateStats renderStateStats;
+    
+    // only used by the command recording benchmark (see buildRecordingBenchmarkQueue)
+    std::vector<InstanceGroup*> syntheticQueue;
 
 	// Models, textures and Descriptors (values assigned to the uniforms)
 	// Please note that Model objects depends on the corresponding vertex structure
@@ -29,6 +49,156 @@ protected:
     
     virtual void buildMultipleInstances(json* instances, json* sceneJson) = 0;
 
+    void loadAssetsInParallel(json& ms, json& ts, VertexDescriptor* vertexDescriptor) {
+        PROFILE_SCOPE("load assets");
+        const int assetCount = ModelCount + TextureCount;
+        std::vector<AssetLoadTiming> timings(assetCount);
+        // workers never print: each asset's messages are buffered and printed by this thread when it is uploaded
+        std::vector<std::ostringstream> logs(assetCount);
+        std::vector<std::exception_ptr> errors(assetCount);
+        
+        std::mutex readyMutex;
+        std::condition_variable readyCondition;
+        std::queue<int> ready;
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        auto elapsedMs = [](std::chrono::high_resolution_clock::time_point from) {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - from).count();
+        };
+        
+        for(int k = 0; k < ModelCount; k++) {
+            std::string modelName = ms[k]["id"];
+            ModelIds[modelName] = k;
+            Models[k] = new Model();
+            timings[k].name = modelName;
+            timings[k].kind = "model";
+        }
+        for(int k = 0; k < TextureCount; k++) {
+            TextureIds[ts[k]["id"]] = k;
+            Textures[k] = new Texture();
+            timings[ModelCount + k].name = ts[k]["id"];
+            timings[ModelCount + k].kind = "texture";
+        }
+        
+        {
+            ThreadPool pool;
+            std::cout << "Loading " << assetCount << " assets on " << pool.size() << " threads\n";
+            
+            for(int a = 0; a < assetCount; a++) {
+                std::function<void(std::ostream&)> decode;
+                if(a < ModelCount) {
+                    std::string MT = ms[a]["format"].template get<std::string>();
+                    ModelType type = (MT[0] == 'O') ? OBJ : ((MT[0] == 'G') ? GLTF : MGCG);
+                    std::string fileName = ms[a]["model"];
+                    Model* model = Models[a];
+                    std::string modelName = timings[a].name;
+                    decode = [=](std::ostream& log) {
+                        PROFILE_SCOPE("decode model");
+                        try {
+                            model->load(EngineBaseProject, vertexDescriptor, modelName, fileName, type, log);
+                        } catch (...) {
+                            model->releaseDecoded();
+                            throw;
+                        }
+                    };
+                } else {
+                    std::string fileName = ts[a - ModelCount]["texture"];
+                    Texture* texture = Textures[a - ModelCount];
+                    decode = [=](std::ostream& log) {
+                        PROFILE_SCOPE("decode texture");
+                        try {
+                            texture->load(EngineBaseProject, fileName, VK_FORMAT_R8G8B8A8_SRGB, log);
+                        } catch (...) {
+                            texture->releaseDecoded();
+                            throw;
+                        }
+                    };
+                }
+                
+                pool.submit([&, a, decode]() {
+                    auto decodeStart = std::chrono::high_resolution_clock::now();
+                    try {
+                        decode(logs[a]);
+                    } catch (const std::exception& e) {
+                        logs[a] << "Failed to load " << timings[a].kind << " " << timings[a].name << ": " << e.what() << "\n";
+                        errors[a] = std::current_exception();
+                    } catch (...) {
+                        logs[a] << "Failed to load " << timings[a].kind << " " << timings[a].name << "\n";
+                        errors[a] = std::current_exception();
+                    }
+                    timings[a].decodeMs = elapsedMs(decodeStart);
+                    {
+                        std::lock_guard<std::mutex> lock(readyMutex);
+                        ready.push(a);
+                    }
+                    readyCondition.notify_one();
+                });
+            }
+            
+            // every transfer of the load phase is recorded into one batch, submitted once at the end
+            UploadBatchScope uploads(EngineBaseProject->getUploadBatch());
+            
+            // after a failure the remaining assets are still decoded and uploaded (the upload releases their
+            // decoded data): the first error is rethrown once the batch is submitted
+            int failed = -1;
+            for(int uploaded = 0; uploaded < assetCount; uploaded++) {
+                int a;
+                {
+                    std::unique_lock<std::mutex> lock(readyMutex);
+                    readyCondition.wait(lock, [&ready] { return !ready.empty(); });
+                    a = ready.front();
+                    ready.pop();
+                }
+                std::cout << logs[a].str();
+                if(errors[a]) {
+                    if(failed < 0) failed = a;
+                    continue;
+                }
+                
+                PROFILE_SCOPE("upload");
+                auto uploadStart = std::chrono::high_resolution_clock::now();
+                if(a < ModelCount) {
+                    Models[a]->upload();
+                } else {
+                    Textures[a - ModelCount]->upload();
+                }
+                timings[a].uploadMs = elapsedMs(uploadStart);
+            }
+            
+            PROFILE_SCOPE("submit uploads");
+            auto submitStart = std::chrono::high_resolution_clock::now();
+            uploads.end();
+            std::cout << "Upload batch submitted in " << elapsedMs(submitStart) << " ms\n";
+            
+            if(failed >= 0) {
+                std::rethrow_exception(errors[failed]);
+            }
+        }
+        
+        printLoadReport(timings, elapsedMs(start));
+    }
+    
+    void printLoadReport(std::vector<AssetLoadTiming> timings, double totalMs) {
+        std::sort(timings.begin(), timings.end(), [](const AssetLoadTiming& a, const AssetLoadTiming& b) {
+            return a.decodeMs + a.uploadMs > b.decodeMs + b.uploadMs;
+        });
+        
+        double decodeSum = 0.0, uploadSum = 0.0;
+        std::cout << "\n---- Asset load report ----\n";
+        std::cout << std::left << std::setw(10) << "kind" << std::setw(28) << "asset"
+                  << std::right << std::setw(12) << "decode ms" << std::setw(12) << "upload ms" << "\n";
+        for(const AssetLoadTiming& t : timings) {
+            std::cout << std::left << std::setw(10) << t.kind << std::setw(28) << t.name << std::right << std::fixed
+                      << std::setprecision(2) << std::setw(12) << t.decodeMs << std::setw(12) << t.uploadMs << "\n";
+            decodeSum += t.decodeMs;
+            uploadSum += t.uploadMs;
+        }
+        std::cout << "Total: " << totalMs << " ms wall, " << decodeSum << " ms decode (summed over threads), "
+                  << uploadSum << " ms upload\n";
+        EngineBaseProject->getMemoryAllocator().printStats();
+        std::cout << "---------------------------\n\n" << std::defaultfloat;
+    }
+
 public:
     
 	void load(std::string file, VertexDescriptor* vertexDescriptor) {
@@ -52,30 +222,18 @@ public:
 			std::cout << "Models count: " << ModelCount << "\n";
 
 			Models = (Model **)calloc(ModelCount, sizeof(Model *));
-			for(int k = 0; k < ModelCount; k++) {
-                std::string modelName = ms[k]["id"];
-				ModelIds[modelName] = k;
-				std::string MT = ms[k]["format"].template get<std::string>();
-                Models[k] = new Model();
-                
-                ModelType type = (MT[0] == 'O') ? OBJ : ((MT[0] == 'G') ? GLTF : MGCG);
-                std::string fileName = ms[k]["model"];
-
-                Models[k]->init(EngineBaseProject, vertexDescriptor, modelName, fileName, type);
-			}
 			
 			// TEXTURES
 			json ts = js["textures"];
 			TextureCount = (int)ts.size();
 			std::cout << "Textures count: " << TextureCount << "\n";
 
-			Textures = (Texture **)calloc(ModelCount, sizeof(Texture *));
-			for(int k = 0; k < TextureCount; k++) {
-				TextureIds[ts[k]["id"]] = k;
-                Textures[k] = new Texture();
-
-                Textures[k]->init(EngineBaseProject, ts[k]["texture"]);
-			}
+			Textures = (Texture **)calloc(TextureCount, sizeof(Texture *));
+            
+            // WARNING: ADDED BY US
+            // Decoding and parsing run on a worker pool; every Vulkan call (the uploads) stays on this thread,
+            // which uploads each asset as soon as a worker has finished decoding it.
+            loadAssetsInParallel(ms, ts, vertexDescriptor);
 
 			// INSTANCES TextureCount
 			Instances = js["instances"];
@@ -109,18 +267,55 @@ public:
         for(auto obj : gameObjects) {
             obj->init();
         }
+        buildInstanceGroups();
     }
     
-    void descriptorSetsInit(DescriptorSetLayout* dsl){
+    // objects sharing model, texture and pipeline are drawn by a single instanced draw call
+    void buildInstanceGroups() {
+        std::map<std::tuple<Model*, Texture*, PipelineType>, InstanceGroup*> groupsByKey;
         for(auto obj : gameObjects) {
-            obj->descriptorSetInit(dsl);
+            auto key = std::make_tuple(obj->getModel(), obj->getTexture(), obj->getPipelineType());
+            auto it = groupsByKey.find(key);
+            if(it == groupsByKey.end()) {
+                InstanceGroup* group = new InstanceGroup(obj->getModel(), obj->getTexture(), obj->getPipelineType());
+                instanceGroups.push_back(group);
+                it = groupsByKey.emplace(key, group).first;
+            }
+            it->second->add(obj);
+        }
+        sortRenderQueue();
+        std::cout << "Instance groups: " << instanceGroups.size() << " for " << gameObjects.size() << " objects\n";
+    }
+    
+    // render queue order: pipeline, then texture, then mesh, so that consecutive draws share as much state as possible
+    void sortRenderQueue() {
+        std::unordered_map<Model*, int> modelIndex;
+        for(int i = 0; i < ModelCount; i++) modelIndex[Models[i]] = i;
+        std::unordered_map<Texture*, int> textureIndex;
+        for(int i = 0; i < TextureCount; i++) textureIndex[Textures[i]] = i;
+        
+        auto key = [&](const InstanceGroup* group) {
+            return std::make_tuple((int)group->getPipelineType(), textureIndex[group->getTexture()], modelIndex[group->getModel()]);
+        };
+        std::stable_sort(instanceGroups.begin(), instanceGroups.end(), [&](const InstanceGroup* a, const InstanceGroup* b) {
+            return key(a) < key(b);
+        });
+    }
+    
+    void descriptorSetsInit(DescriptorSetLayout* globalDsl, DescriptorSetLayout* dsl){
+        globalDescriptorSet.init(EngineBaseProject, globalDsl, {
+            {0, UNIFORM, sizeof(GlobalUniformBufferObject), nullptr}
+        });
+        for(auto group : instanceGroups) {
+            group->descriptorSetInit(dsl);
         }
     }
 	
 	void pipelinesAndDescriptorSetsCleanup() {
 		// Cleanup datasets
-        for (auto obj : gameObjects) {
-            obj->descriptorSetCleanup();
+        globalDescriptorSet.cleanup();
+        for (auto group : instanceGroups) {
+            group->descriptorSetCleanup();
         }
 	}
     
@@ -128,15 +323,117 @@ public:
         for (auto obj : gameObjects) {
             obj->localCleanup();
         }
+        for (auto group : instanceGroups) {
+            delete group;
+        }
+        instanceGroups.clear();
         free(Models);
         free(Textures);
     }
 	
-    void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage, std::unordered_map<PipelineType, Pipeline*> pipelines) {
-        for(auto obj : gameObjects) {
-            obj->populateCommandBuffer(commandBuffer, currentImage, pipelines[obj->getPipelineType()]);
+    // Walks [first, last) of the render queue and only records the state that changes between two draws.
+    // All the scene pipeline layouts share set 0, so the global descriptor set survives pipeline switches.
+    // Nothing is written but the command buffer, so disjoint ranges can be recorded by different threads.
+    // the queue is sorted by pipeline, so each pipeline group is one run of the range, timed as such by gpuTimer
+    RenderStateStats recordDrawRange(VkCommandBuffer commandBuffer, int currentImage,
+                                     const std::unordered_map<PipelineType, Pipeline*>& pipelines,
+                                     const std::vector<InstanceGroup*>& queue, size_t first, size_t last,
+                                     const GpuTimer* gpuTimer = nullptr, unsigned chunk = 0) const {
+        RenderStateStats stats;
+        Pipeline* boundPipeline = nullptr;
+        PipelineType boundType = PHONG;
+        Model* boundModel = nullptr;
+        
+        for(size_t i = first; i < last; i++) {
+            InstanceGroup* group = queue[i];
+            Pipeline* pipeline = pipelines.at(group->getPipelineType());
+            if(pipeline != boundPipeline) {
+                if(gpuTimer != nullptr) {
+                    if(boundPipeline != nullptr) gpuTimer->endGroup(commandBuffer, currentImage, chunk, boundType);
+                    gpuTimer->beginGroup(commandBuffer, currentImage, chunk, group->getPipelineType());
+                }
+                boundType = group->getPipelineType();
+                pipeline->bind(commandBuffer);
+                stats.pipelineBinds++;
+                if(boundPipeline == nullptr) {
+                    globalDescriptorSet.bind(commandBuffer, *pipeline, 0, currentImage);
+                    stats.descriptorSetBinds++;
+                }
+                boundPipeline = pipeline;
+            }
+            if(group->getModel() != boundModel) {
+                group->getModel()->bind(commandBuffer);
+                stats.vertexBufferBinds++;
+                boundModel = group->getModel();
+            }
+            group->populateCommandBuffer(commandBuffer, currentImage, pipeline);
+            stats.descriptorSetBinds++;
+            stats.drawCalls++;
+        }
+        if(gpuTimer != nullptr && boundPipeline != nullptr) {
+            gpuTimer->endGroup(commandBuffer, currentImage, chunk, boundType);
         }
+        return stats;
+    }
+    
+    // the synthetic queue of the recording benchmark replaces the instance groups when it is set
+    const std::vector<InstanceGroup*>& renderQueue() const {
+        return syntheticQueue.empty() ? instanceGroups : syntheticQueue;
+    }
+	
+    void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage, std::unordered_map<PipelineType, Pipeline*> pipelines,
+                               const GpuTimer* gpuTimer = nullptr) {
+        RenderStateStats stats = recordDrawRange(commandBuffer, currentImage, pipelines, renderQueue(), 0, renderQueue().size(), gpuTimer);
+        
+        renderStateStats = stats;
+        EngineBaseProject->getRenderStats().addRecorded(stats);
 	}
+    
+    // Same as populateCommandBuffer, split across the recorder threads: every chunk starts from an
+    // unknown state (secondaries inherit nothing), so it binds its first pipeline, global set and model again.
+    // drawAfter records what goes on top of the scene (the last chunk calls it, after its draws).
+    const std::vector<VkCommandBuffer>& populateCommandBufferParallel(ParallelRecorder& recorder, int currentImage,
+                                                                      const std::unordered_map<PipelineType, Pipeline*>& pipelines,
+                                                                      const GpuTimer* gpuTimer = nullptr,
+                                                                      const std::function<void(VkCommandBuffer)>& drawAfter = nullptr) {
+        const std::vector<InstanceGroup*>& queue = renderQueue();
+        std::vector<RenderStateStats> chunkStats(recorder.getThreadCount());
+        
+        const std::vector<VkCommandBuffer>& secondaries = recorder.record(currentImage, queue.size(),
+            [&](VkCommandBuffer commandBuffer, unsigned chunk, size_t first, size_t last) {
+                chunkStats[chunk] = recordDrawRange(commandBuffer, currentImage, pipelines, queue, first, last, gpuTimer, chunk);
+                if(last == queue.size() && drawAfter) {
+                    drawAfter(commandBuffer);
+                }
+            });
+        
+        RenderStateStats stats;
+        for(const RenderStateStats& chunk : chunkStats) {
+            stats += chunk;
+        }
+        if(syntheticQueue.empty()) {
+            renderStateStats = stats;
+            EngineBaseProject->getRenderStats().addRecorded(stats);
+        }
+        return secondaries;
+    }
+    
+    // objects entries drawn one at a time, each instance group repeated in place so the queue stays sorted:
+    // the CPU recording cost of a scene with that many non instanced objects
+    void buildRecordingBenchmarkQueue(size_t objects) {
+        syntheticQueue.clear();
+        if(instanceGroups.empty()) return;
+        syntheticQueue.reserve(objects);
+        size_t perGroup = objects / instanceGroups.size();
+        size_t extra = objects % instanceGroups.size();
+        for(size_t g = 0; g < instanceGroups.size(); g++) {
+            syntheticQueue.insert(syntheticQueue.end(), perGroup + (g < extra ? 1 : 0), instanceGroups[g]);
+        }
+    }
+    
+    const RenderStateStats& getRenderStateStats() const {
+        return renderStateStats;
+    }
 };
     
 #endif
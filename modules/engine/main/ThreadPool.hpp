@@ -0,0 +1,88 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "Profiler.hpp"
+
+// Fixed-size pool of worker threads consuming a FIFO of tasks.
+// Workers must never touch Vulkan queues: results are handed back to the owning thread.
+class ThreadPool {
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void workerLoop() {
+        PROFILE_THREAD_NAME("worker");
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+
+    // threadCount = 0 sizes the pool to the machine
+    explicit ThreadPool(unsigned threadCount = 0) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        workers.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const {
+        return (unsigned)workers.size();
+    }
+
+    // Exceptions thrown by the task are rethrown by the returned future's get()
+    template<class F>
+    auto submit(F&& f) -> std::future<decltype(f())> {
+        using Result = decltype(f());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([task] { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+};
+
+#endif
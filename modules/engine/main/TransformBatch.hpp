@@ -0,0 +1,327 @@
+#ifndef TRANSFORM_BATCH_HPP
+#define TRANSFORM_BATCH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// same GLM configuration as Starter.hpp, whichever of the two headers is included first
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#ifndef GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#endif
+#ifndef GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#define TRANSFORM_BATCH_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_BATCH_SSE
+#endif
+#if defined(TRANSFORM_BATCH_AVX) || defined(TRANSFORM_BATCH_SSE)
+#include <immintrin.h>
+#endif
+
+/*
+ Normal matrices (and optionally model-view-projection matrices) of many affine transforms in one pass.
+ The transforms are stored as a structure of arrays, one array per element of their 3x4 affine part
+ (the bottom row is always 0 0 0 1), so the kernel processes 8 (AVX), 4 (SSE) or 1 (scalar) transforms
+ per instruction with plain loads and stores. The widest instruction set the compiler targets is used
+ (AVX needs -mavx or /arch:AVX); TRANSFORM_BATCH_SCALAR forces the scalar kernel.
+
+ The normal matrix is the inverse transpose of the 3x3 part M = [c0 c1 c2]. For a rotation with a
+ uniform scale (every transform the game builds) it is just M / s^2, with s^2 = |c0|^2: a block whose
+ transforms all pass that test (orthogonal columns of equal length, relative tolerance
+ TRANSFORM_BATCH_RIGID_TOLERANCE) takes this path; any other block uses the cofactors,
+ inverse(M)^T = [c1 x c2, c2 x c0, c0 x c1] / det(M). Only the upper 3x3 of the normal matrices is
+ written (the rest is the identity): the shaders use mat3(nMat).
+ The arrays are padded with identities to a multiple of TRANSFORM_BATCH_LANES, so there is no tail.
+ */
+
+const size_t TRANSFORM_BATCH_LANES = 8;
+const float TRANSFORM_BATCH_RIGID_TOLERANCE = 1e-4f;
+
+enum TransformKernel {
+    TRANSFORM_KERNEL_SCALAR,
+    TRANSFORM_KERNEL_SSE,
+    TRANSFORM_KERNEL_AVX
+};
+
+// one lane per transform: float
+struct TransformLanesScalar {
+    using V = float;
+    using Mask = bool;
+    static constexpr size_t width = 1;
+    static V load(const float* p) { return *p; }
+    static void store(float* p, V v) { *p = v; }
+    static V set1(float f) { return f; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V abs(V a) { return std::fabs(a); }
+    static Mask lessEqual(V a, V b) { return a <= b; }
+    static Mask both(Mask a, Mask b) { return a && b; }
+    static bool all(Mask m) { return m; }
+};
+
+#ifdef TRANSFORM_BATCH_SSE
+struct TransformLanesSSE {
+    using V = __m128;
+    using Mask = __m128;
+    static constexpr size_t width = 4;
+    static V load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+    static V set1(float f) { return _mm_set1_ps(f); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Mask lessEqual(V a, V b) { return _mm_cmple_ps(a, b); }
+    static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static bool all(Mask m) { return _mm_movemask_ps(m) == 0xF; }
+};
+#endif
+
+#ifdef TRANSFORM_BATCH_AVX
+struct TransformLanesAVX {
+    using V = __m256;
+    using Mask = __m256;
+    static constexpr size_t width = 8;
+    static V load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(float f) { return _mm256_set1_ps(f); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Mask lessEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static bool all(Mask m) { return _mm256_movemask_ps(m) == 0xFF; }
+};
+#endif
+
+class TransformBatch {
+
+    // element (column c, row r) of the 3x4 affine part is elements[3 * c + r]
+    std::vector<float> elements[12];
+    std::vector<float> normals[9];      // upper 3x3 of the normal matrices, same layout
+    std::vector<float> mvps[16];        // column-major 4x4, only written by compute with a view-projection
+    size_t count = 0;
+    size_t rigidTransforms = 0;         // of the last compute: the transforms that took the M / s^2 path
+
+    template<class L>
+    static typename L::V dot(typename L::V ax, typename L::V ay, typename L::V az,
+                             typename L::V bx, typename L::V by, typename L::V bz) {
+        return L::add(L::add(L::mul(ax, bx), L::mul(ay, by)), L::mul(az, bz));
+    }
+
+    // (a x b) * scale into out[0..2] at lane i
+    template<class L>
+    static void storeCross(float* const* out, size_t i, typename L::V scale,
+                           typename L::V ax, typename L::V ay, typename L::V az,
+                           typename L::V bx, typename L::V by, typename L::V bz) {
+        L::store(out[0] + i, L::mul(L::sub(L::mul(ay, bz), L::mul(az, by)), scale));
+        L::store(out[1] + i, L::mul(L::sub(L::mul(az, bx), L::mul(ax, bz)), scale));
+        L::store(out[2] + i, L::mul(L::sub(L::mul(ax, by), L::mul(ay, bx)), scale));
+    }
+
+    template<class L>
+    void computeWith(const glm::mat4* viewProjection) {
+        using V = typename L::V;
+        const V zero = L::set1(0.0f);
+        const V one = L::set1(1.0f);
+        const V tolerance = L::set1(TRANSFORM_BATCH_RIGID_TOLERANCE);
+        float* n[9];
+        for (size_t e = 0; e < 9; e++) n[e] = normals[e].data();
+        rigidTransforms = 0;
+
+        for (size_t i = 0; i < elements[0].size(); i += L::width) {
+            V c0x = L::load(elements[0].data() + i), c0y = L::load(elements[1].data() + i), c0z = L::load(elements[2].data() + i);
+            V c1x = L::load(elements[3].data() + i), c1y = L::load(elements[4].data() + i), c1z = L::load(elements[5].data() + i);
+            V c2x = L::load(elements[6].data() + i), c2y = L::load(elements[7].data() + i), c2z = L::load(elements[8].data() + i);
+
+            // rotation times uniform scale: orthogonal columns, all of squared length s^2
+            V s2 = dot<L>(c0x, c0y, c0z, c0x, c0y, c0z);
+            V limit = L::mul(s2, tolerance);
+            typename L::Mask rigid = L::both(
+                L::both(L::lessEqual(L::abs(L::sub(dot<L>(c1x, c1y, c1z, c1x, c1y, c1z), s2)), limit),
+                        L::lessEqual(L::abs(L::sub(dot<L>(c2x, c2y, c2z, c2x, c2y, c2z), s2)), limit)),
+                L::both(L::both(L::lessEqual(L::abs(dot<L>(c0x, c0y, c0z, c1x, c1y, c1z)), limit),
+                                L::lessEqual(L::abs(dot<L>(c0x, c0y, c0z, c2x, c2y, c2z)), limit)),
+                        L::lessEqual(L::abs(dot<L>(c1x, c1y, c1z, c2x, c2y, c2z)), limit)));
+
+            if (L::all(rigid)) {
+                V inverseS2 = L::div(one, s2);
+                L::store(n[0] + i, L::mul(c0x, inverseS2));
+                L::store(n[1] + i, L::mul(c0y, inverseS2));
+                L::store(n[2] + i, L::mul(c0z, inverseS2));
+                L::store(n[3] + i, L::mul(c1x, inverseS2));
+                L::store(n[4] + i, L::mul(c1y, inverseS2));
+                L::store(n[5] + i, L::mul(c1z, inverseS2));
+                L::store(n[6] + i, L::mul(c2x, inverseS2));
+                L::store(n[7] + i, L::mul(c2y, inverseS2));
+                L::store(n[8] + i, L::mul(c2z, inverseS2));
+                rigidTransforms += i < count ? std::min(L::width, count - i) : 0;
+            } else {
+                // det(M) = c0 . (c1 x c2)
+                V crossX = L::sub(L::mul(c1y, c2z), L::mul(c1z, c2y));
+                V crossY = L::sub(L::mul(c1z, c2x), L::mul(c1x, c2z));
+                V crossZ = L::sub(L::mul(c1x, c2y), L::mul(c1y, c2x));
+                V inverseDet = L::div(one, dot<L>(c0x, c0y, c0z, crossX, crossY, crossZ));
+                L::store(n[0] + i, L::mul(crossX, inverseDet));
+                L::store(n[1] + i, L::mul(crossY, inverseDet));
+                L::store(n[2] + i, L::mul(crossZ, inverseDet));
+                storeCross<L>(n + 3, i, inverseDet, c2x, c2y, c2z, c0x, c0y, c0z);
+                storeCross<L>(n + 6, i, inverseDet, c0x, c0y, c0z, c1x, c1y, c1z);
+            }
+
+            if (viewProjection != nullptr) {
+                const glm::mat4& vp = *viewProjection;
+                V tx = L::load(elements[9].data() + i), ty = L::load(elements[10].data() + i), tz = L::load(elements[11].data() + i);
+                V columns[4][3] = {{c0x, c0y, c0z}, {c1x, c1y, c1z}, {c2x, c2y, c2z}, {tx, ty, tz}};
+                for (int c = 0; c < 4; c++) {
+                    for (int r = 0; r < 4; r++) {
+                        // row r of vp times column c of the model matrix (whose w is 0, or 1 for the translation)
+                        V value = L::add(L::add(L::mul(L::set1(vp[0][r]), columns[c][0]),
+                                                L::mul(L::set1(vp[1][r]), columns[c][1])),
+                                         L::mul(L::set1(vp[2][r]), columns[c][2]));
+                        L::store(mvps[4 * c + r].data() + i, L::add(value, c == 3 ? L::set1(vp[3][r]) : zero));
+                    }
+                }
+            }
+        }
+    }
+
+public:
+
+    static TransformKernel defaultKernel() {
+#if defined(TRANSFORM_BATCH_SCALAR)
+        return TRANSFORM_KERNEL_SCALAR;
+#elif defined(TRANSFORM_BATCH_AVX)
+        return TRANSFORM_KERNEL_AVX;
+#elif defined(TRANSFORM_BATCH_SSE)
+        return TRANSFORM_KERNEL_SSE;
+#else
+        return TRANSFORM_KERNEL_SCALAR;
+#endif
+    }
+
+    static bool isAvailable(TransformKernel kernel) {
+        switch (kernel) {
+            case TRANSFORM_KERNEL_SCALAR:
+                return true;
+            case TRANSFORM_KERNEL_SSE:
+#ifdef TRANSFORM_BATCH_SSE
+                return true;
+#else
+                return false;
+#endif
+            case TRANSFORM_KERNEL_AVX:
+#ifdef TRANSFORM_BATCH_AVX
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    static const char* kernelName(TransformKernel kernel) {
+        switch (kernel) {
+            case TRANSFORM_KERNEL_SCALAR: return "scalar";
+            case TRANSFORM_KERNEL_SSE: return "sse";
+            case TRANSFORM_KERNEL_AVX: return "avx";
+        }
+        return "?";
+    }
+
+    // the existing transforms are kept, new ones are identities
+    void resize(size_t transforms) {
+        size_t padded = (transforms + TRANSFORM_BATCH_LANES - 1) / TRANSFORM_BATCH_LANES * TRANSFORM_BATCH_LANES;
+        for (size_t e = 0; e < 12; e++) {
+            elements[e].resize(padded, (e == 0 || e == 4 || e == 8) ? 1.0f : 0.0f);
+        }
+        for (size_t e = 0; e < 9; e++) normals[e].resize(padded);
+        if (!mvps[0].empty()) {
+            for (size_t e = 0; e < 16; e++) mvps[e].resize(padded);
+        }
+        // the padding may still hold transforms of the previous count: identities again
+        for (size_t i = transforms; i < std::min(count, padded); i++) {
+            set(i, glm::mat4(1.0f));
+        }
+        count = transforms;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // the affine part of the transform (its bottom row is taken as 0 0 0 1)
+    void set(size_t i, const glm::mat4& transform) {
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 3; r++) {
+                elements[3 * c + r][i] = transform[c][r];
+            }
+        }
+    }
+
+    // normal matrices of every transform and, with a view-projection, their viewProjection * transform
+    void compute(const glm::mat4* viewProjection = nullptr, TransformKernel kernel = defaultKernel()) {
+        if (viewProjection != nullptr && mvps[0].size() != elements[0].size()) {
+            for (size_t e = 0; e < 16; e++) mvps[e].resize(elements[0].size());
+        }
+        switch (kernel) {
+#ifdef TRANSFORM_BATCH_AVX
+            case TRANSFORM_KERNEL_AVX:
+                computeWith<TransformLanesAVX>(viewProjection);
+                return;
+#endif
+#ifdef TRANSFORM_BATCH_SSE
+            case TRANSFORM_KERNEL_SSE:
+                computeWith<TransformLanesSSE>(viewProjection);
+                return;
+#endif
+            default:
+                computeWith<TransformLanesScalar>(viewProjection);
+                return;
+        }
+    }
+
+    // transforms of the last compute that took the M / s^2 path: a block with any other transform takes
+    // the cofactors for all of its lanes
+    size_t getRigidCount() const {
+        return rigidTransforms;
+    }
+
+    glm::mat4 getNormalMatrix(size_t i) const {
+        glm::mat4 normal(1.0f);
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++) {
+                normal[c][r] = normals[3 * c + r][i];
+            }
+        }
+        return normal;
+    }
+
+    // only after compute with a view-projection
+    glm::mat4 getMvp(size_t i) const {
+        glm::mat4 mvp;
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                mvp[c][r] = mvps[4 * c + r][i];
+            }
+        }
+        return mvp;
+    }
+};
+
+#endif
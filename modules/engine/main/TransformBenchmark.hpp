@@ -0,0 +1,175 @@
+#ifndef TRANSFORM_BENCHMARK_HPP
+#define TRANSFORM_BENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "TransformBatch.hpp"
+#include <glm/gtc/matrix_transform.hpp>   // after TransformBatch.hpp, which sets the GLM configuration
+
+/*
+ Microbenchmark of the per-object matrices (--transform-benchmark): for 500, 5k and 50k random transforms,
+ the per-object glm path (viewProjection * model and inverse(transpose(model)), the latter being what
+ GameObject computes when its transform changes) against TransformBatch with every kernel compiled in,
+ with and without the view-projection, and with the gather / scatter between glm matrices and the arrays
+ included. The game keeps its transforms in the objects, so it would pay the gather / scatter: with it
+ the batch measures no faster than glm, and the draw manager does not use it.
+ Two sets of transforms: rotations with a uniform scale (the cheap inverse) and ones with a non-uniform
+ scale (the cofactors). Needs no Vulkan: it runs before the app starts and prints, for each case, the
+ nanoseconds per object (best of TRANSFORM_BENCHMARK_RUNS runs) and the largest difference from glm.
+ */
+
+const int TRANSFORM_BENCHMARK_RUNS = 5;
+const size_t TRANSFORM_BENCHMARK_OBJECTS_PER_RUN = 2000000;
+
+struct TransformBenchmarkCase {
+    std::string name;
+    std::function<void()> run;
+};
+
+// random affine transforms: rotation, scale (uniform or not) and translation
+inline std::vector<glm::mat4> makeBenchmarkTransforms(size_t count, bool uniformScale, std::mt19937& random) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.1f, 10.0f);
+    std::vector<glm::mat4> transforms(count);
+    for (glm::mat4& transform : transforms) {
+        glm::vec3 axis(unit(random), unit(random), unit(random));
+        if (glm::length(axis) < 1e-3f) axis = glm::vec3(0.0f, 1.0f, 0.0f);
+        float s = scale(random);
+        glm::vec3 scales = uniformScale ? glm::vec3(s) : glm::vec3(s, scale(random), scale(random));
+        transform = glm::translate(glm::mat4(1.0f), 500.0f * glm::vec3(unit(random), unit(random), unit(random)))
+                  * glm::rotate(glm::mat4(1.0f), 3.14159f * unit(random), glm::normalize(axis))
+                  * glm::scale(glm::mat4(1.0f), scales);
+    }
+    return transforms;
+}
+
+// largest |a - b| / max(1, |b|) over the elements compared
+inline float transformBenchmarkError(const glm::mat4& a, const glm::mat4& b, int size) {
+    float error = 0.0f;
+    for (int c = 0; c < size; c++) {
+        for (int r = 0; r < size; r++) {
+            error = std::max(error, std::fabs(a[c][r] - b[c][r]) / std::max(1.0f, std::fabs(b[c][r])));
+        }
+    }
+    return error;
+}
+
+inline void runTransformBenchmark() {
+    const std::vector<size_t> counts = {500, 5000, 50000};
+    std::mt19937 random(1234);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+                             * glm::lookAt(glm::vec3(10.0f, 20.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<TransformKernel> kernels;
+    for (TransformKernel kernel : {TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_AVX}) {
+        if (TransformBatch::isAvailable(kernel)) kernels.push_back(kernel);
+    }
+    std::cout << "Transform benchmark: ns per object, best of " << TRANSFORM_BENCHMARK_RUNS << " runs (default kernel: "
+              << TransformBatch::kernelName(TransformBatch::defaultKernel()) << ")\n";
+
+    for (bool uniformScale : {true, false}) {
+        std::cout << "\n" << (uniformScale ? "rotation + uniform scale" : "non-uniform scale") << "\n";
+        std::printf("%-40s", "case");
+        for (size_t count : counts) std::printf("%12zu", count);
+        std::printf("%14s\n", "max error");
+
+        std::vector<std::vector<glm::mat4>> transforms;
+        for (size_t count : counts) transforms.push_back(makeBenchmarkTransforms(count, uniformScale, random));
+
+        // one row per case, one column per object count
+        std::vector<std::string> names;
+        std::vector<std::vector<double>> times;
+        std::vector<float> errors;
+        float checksum = 0.0f;
+
+        for (size_t c = 0; c < counts.size(); c++) {
+            const std::vector<glm::mat4>& models = transforms[c];
+            size_t count = models.size();
+            std::vector<glm::mat4> mvps(count), normals(count);
+            TransformBatch batch;
+            batch.resize(count);
+            for (size_t i = 0; i < count; i++) batch.set(i, models[i]);
+
+            std::vector<TransformBenchmarkCase> cases;
+            cases.push_back({"glm per object (mvp + normal)", [&]() {
+                for (size_t i = 0; i < count; i++) {
+                    mvps[i] = viewProjection * models[i];
+                    normals[i] = glm::inverse(glm::transpose(models[i]));
+                }
+            }});
+            cases.push_back({"glm per object (normal)", [&]() {
+                for (size_t i = 0; i < count; i++) {
+                    normals[i] = glm::inverse(glm::transpose(models[i]));
+                }
+            }});
+            for (TransformKernel kernel : kernels) {
+                std::string name = TransformBatch::kernelName(kernel);
+                cases.push_back({name + " batch (mvp + normal)", [&, kernel]() {
+                    batch.compute(&viewProjection, kernel);
+                }});
+                cases.push_back({name + " batch (normal)", [&, kernel]() {
+                    batch.compute(nullptr, kernel);
+                }});
+                cases.push_back({name + " batch + gather/scatter (normal)", [&, kernel]() {
+                    for (size_t i = 0; i < count; i++) batch.set(i, models[i]);
+                    batch.compute(nullptr, kernel);
+                    for (size_t i = 0; i < count; i++) normals[i] = batch.getNormalMatrix(i);
+                }});
+            }
+
+            size_t repetitions = std::max<size_t>(1, TRANSFORM_BENCHMARK_OBJECTS_PER_RUN / count);
+            for (size_t k = 0; k < cases.size(); k++) {
+                double best = 0.0;
+                for (int run = 0; run < TRANSFORM_BENCHMARK_RUNS; run++) {
+                    auto start = std::chrono::steady_clock::now();
+                    for (size_t repetition = 0; repetition < repetitions; repetition++) {
+                        cases[k].run();
+                    }
+                    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                              / (double)(repetitions * count);
+                    best = run == 0 ? ns : std::min(best, ns);
+                }
+                checksum += normals[count / 2][1][1];
+
+                // against glm: the batch results are still in the batch, the glm ones are recomputed
+                float error = 0.0f;
+                if (k >= 2) {
+                    for (size_t i = 0; i < count; i++) {
+                        error = std::max(error, transformBenchmarkError(batch.getNormalMatrix(i), glm::inverse(glm::transpose(models[i])), 3));
+                        if (cases[k].name.find("mvp") != std::string::npos) {
+                            error = std::max(error, transformBenchmarkError(batch.getMvp(i), viewProjection * models[i], 4));
+                        }
+                    }
+                }
+
+                if (c == 0) {
+                    names.push_back(cases[k].name);
+                    times.emplace_back();
+                    errors.push_back(0.0f);
+                }
+                times[k].push_back(best);
+                errors[k] = std::max(errors[k], error);
+            }
+        }
+
+        for (size_t k = 0; k < names.size(); k++) {
+            std::printf("%-40s", names[k].c_str());
+            for (double ns : times[k]) std::printf("%12.2f", ns);
+            if (k >= 2) {
+                std::printf("%14.2e\n", errors[k]);
+            } else {
+                std::printf("%14s\n", "-");
+            }
+        }
+        std::cout << "(checksum " << checksum << ")\n";
+    }
+}
+
+#endif
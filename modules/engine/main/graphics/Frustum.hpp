@@ -0,0 +1,62 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+/*
+ View frustum extracted from a view-projection matrix (Gribb and Hartmann), for Vulkan clip space
+ (GLM_FORCE_DEPTH_ZERO_TO_ONE, so the near plane is z >= 0).
+ Plane normals point inside: a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all six planes.
+ */
+struct Frustum {
+
+    glm::vec4 planes[6];
+
+    static Frustum fromViewProjection(const glm::mat4& vp) {
+        glm::vec4 row0(vp[0][0], vp[1][0], vp[2][0], vp[3][0]);
+        glm::vec4 row1(vp[0][1], vp[1][1], vp[2][1], vp[3][1]);
+        glm::vec4 row2(vp[0][2], vp[1][2], vp[2][2], vp[3][2]);
+        glm::vec4 row3(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;    // left
+        frustum.planes[1] = row3 - row0;    // right
+        frustum.planes[2] = row3 + row1;    // bottom
+        frustum.planes[3] = row3 - row1;    // top
+        frustum.planes[4] = row2;           // near
+        frustum.planes[5] = row3 - row2;    // far
+        for (glm::vec4& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        }
+        return true;
+    }
+
+    // axis aligned box given as center and half extent
+    bool intersectsBox(const glm::vec3& center, const glm::vec3& extent) const {
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 normal(plane);
+            if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + plane.w < 0.0f) return false;
+        }
+        return true;
+    }
+
+    // Model space bounds (sphere first, as the cheaper test) moved to world space by the given matrix
+    bool intersects(const glm::mat4& world, const glm::vec3& boundsCenter, float boundsRadius,
+                    const glm::vec3& boundsExtent) const {
+        glm::vec3 center = glm::vec3(world * glm::vec4(boundsCenter, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(world[0])),
+                               std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        if (!intersectsSphere(center, boundsRadius * scale)) return false;
+
+        // world space AABB of the transformed box (Arvo)
+        glm::mat3 absolute(glm::abs(glm::vec3(world[0])), glm::abs(glm::vec3(world[1])), glm::abs(glm::vec3(world[2])));
+        return intersectsBox(center, absolute * boundsExtent);
+    }
+};
+
+#endif
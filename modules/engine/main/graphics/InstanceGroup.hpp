@@ -0,0 +1,163 @@
+#ifndef INSTANCE_GROUP_HPP
+#define INSTANCE_GROUP_HPP
+
+#include "../GameObject.hpp"
+#include "Frustum.hpp"
+#include "tools/Types.hpp"
+
+/*
+ All the game objects sharing the same model, texture and pipeline, drawn with one instanced draw call.
+ The per-object uniforms (the UBO struct of the pipeline) are packed into a storage buffer that the
+ vertex shader indexes with gl_InstanceIndex, so the group needs a single descriptor set (set 1 of the
+ scene pipelines; set 0 holds the global uniforms shared by every group).
+ Only the instances that pass the frustum test are written, packed at the front of the storage buffer;
+ their count goes into an indirect draw command, so the prerecorded command buffers never change.
+ Every image remembers which objects it was last written with and their transform versions, and the
+ upload is skipped as long as the same objects are visible and none of them moved. The camera only
+ changes the view-projection of the global uniforms, so static objects are written again only when
+ the culling changes.
+ */
+class InstanceGroup {
+
+public:
+
+    InstanceGroup(Model* m, Texture* t, PipelineType pt) : model(m), texture(t), pipelineType(pt) {}
+
+    Model* getModel() const { return model; }
+    Texture* getTexture() const { return texture; }
+    PipelineType getPipelineType() const { return pipelineType; }
+    const std::vector<GameObject*>& getObjects() const { return objects; }
+    uint32_t getInstanceCount() const { return (uint32_t)objects.size(); }
+
+    void add(GameObject* obj) {
+        objects.push_back(obj);
+    }
+
+    // size of one element of the instance storage buffer (std430 layout, same as the C++ struct)
+    static size_t instanceSize(PipelineType pt) {
+        switch(pt){
+            case COOK_TORRANCE:
+                return sizeof(CookTorranceUniformBufferObject);
+            case PHONG:
+                return sizeof(PhongUniformBufferObject);
+            case TOON:
+                return sizeof(ToonUniformBufferObject);
+        }
+        return 0;
+    }
+
+    void descriptorSetInit(DescriptorSetLayout* dsl){
+        instanceData.assign(instanceSize(pipelineType) * objects.size(), 0);
+        descriptorSet.init(EngineBaseProject, dsl, {
+            {0, STORAGE, (int)instanceData.size(), nullptr},
+            {1, TEXTURE, 0, texture}
+        });
+        
+        BaseProject* BP = EngineBaseProject;
+        size_t imageCount = BP->swapChainImages.size();
+        uploaded.assign(imageCount, {});
+        indirectBuffers.resize(imageCount);
+        indirectBuffersMemory.resize(imageCount);
+        for (size_t i = 0; i < imageCount; i++) {
+            BP->createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                             indirectBuffers[i], indirectBuffersMemory[i]);
+        }
+    }
+
+    void descriptorSetCleanup() {
+        descriptorSet.cleanup();
+        for (size_t i = 0; i < indirectBuffers.size(); i++) {
+            EngineBaseProject->destroyBuffer(indirectBuffers[i]);
+            EngineBaseProject->memoryAllocator.free(indirectBuffersMemory[i]);
+        }
+        indirectBuffers.clear();
+        indirectBuffersMemory.clear();
+        uploaded.clear();
+    }
+
+    bool isVisible(const GameObject* obj, const Frustum& frustum) const {
+        return frustum.intersects(obj->getWorldMatrix(), model->boundsCenter, model->boundsRadius, model->boundsExtent);
+    }
+
+    template<class UBO>
+    void setInstance(size_t instance, const UBO& ubo) {
+        memcpy(&instanceData[instance * sizeof(UBO)], &ubo, sizeof(UBO));
+    }
+
+    // true if the image's storage buffer and draw command already hold these objects, in this order, with
+    // their current transforms: neither the instances nor the upload need to be done again
+    bool isUploaded(int currentImage, const std::vector<GameObject*>& visible) const {
+        const UploadedInstances& last = uploaded[currentImage];
+        return last.valid && last.objects == visible && last.transformVersions == transformVersionSum(visible);
+    }
+
+    // uploads the instances set for the visible objects (the first visible.size()) and the draw command
+    // that renders them
+    void mapMemory(int currentImage, const std::vector<GameObject*>& visible) {
+        uint32_t visibleCount = (uint32_t)visible.size();
+        if (visibleCount > 0) {
+            descriptorSet.map(currentImage, instanceData.data(), (int)(visibleCount * instanceSize(pipelineType)), 0);
+        }
+        
+        VkDrawIndexedIndirectCommand command{};
+        command.indexCount = static_cast<uint32_t>(model->indices.size());
+        command.instanceCount = visibleCount;
+        MemoryAllocation& memory = indirectBuffersMemory[currentImage];
+        memcpy(memory.mapped, &command, sizeof(command));
+        EngineBaseProject->memoryAllocator.flush(memory, 0, sizeof(command));
+
+        UploadedInstances& last = uploaded[currentImage];
+        last.valid = true;
+        last.objects = visible;
+        last.transformVersions = transformVersionSum(visible);
+    }
+
+    // the triangles drawn this frame, whether the instances were uploaded or not
+    void countTriangles(uint32_t visibleCount) const {
+        EngineBaseProject->renderStats.addTriangles((uint64_t)model->indices.size() / 3 * visibleCount);
+    }
+
+    // the pipeline, the global descriptor set (set 0) and the model buffers must already be bound
+    void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage, Pipeline* pipeline) {
+        descriptorSet.bind(commandBuffer, *pipeline, 1, currentImage);
+
+        vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffers[currentImage], 0, 1,
+                sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+private:
+
+    // what the buffers of an image were last written with
+    struct UploadedInstances {
+        bool valid = false;
+        std::vector<GameObject*> objects;
+        uint64_t transformVersions = 0;     // sum: versions only grow, so it changes whenever one of them does
+    };
+
+    static uint64_t transformVersionSum(const std::vector<GameObject*>& objects) {
+        uint64_t sum = 0;
+        for (const GameObject* obj : objects) {
+            sum += obj->getTransformVersion();
+        }
+        return sum;
+    }
+
+    Model* model;
+    Texture* texture;
+    PipelineType pipelineType;
+    std::vector<GameObject*> objects;
+
+    DescriptorSet descriptorSet;
+    // CPU copy of the instance storage buffer, written by the draw manager when it must be uploaded
+    std::vector<unsigned char> instanceData;
+    
+    // one VkDrawIndexedIndirectCommand per swap chain image
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<MemoryAllocation> indirectBuffersMemory;
+
+    std::vector<UploadedInstances> uploaded;    // one per swap chain image
+
+};
+
+#endif
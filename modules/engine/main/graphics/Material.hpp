@@ -0,0 +1,15 @@
+#ifndef MATERIAL_HPP
+#define MATERIAL_HPP
+
+#include <string>
+#include <unordered_map>
+
+#include "PipelineTypes.hpp"
+
+// How a family of game objects is shaded: the pipeline that draws them and its per-object parameters
+struct Material {
+    PipelineType pipelineType;
+    std::unordered_map<std::string, float> properties;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../main/Profiler.hpp"
+
+/*
+ GPU time of the passes of a frame, from timestamp queries.
+ Every swap chain image has its own query pool, reset at the start of its scene command buffer (outside
+ the render pass) and written again each time the image's command buffers run:
+
+    0, 1    scene render pass begin / end
+    2, 3    UI render pass begin / end
+    4 ...   begin / end of every pipeline group, for every recording chunk (chunk-major)
+
+ A pipeline group is the run of draws that share a pipeline; with the parallel recorder a group can be
+ split across the chunks, each chunk times its own part and the parts are added up. The group timestamps
+ are taken at the bottom of the pipe, so each one measures from the end of the work before it to the end
+ of its own draws: draws of consecutive groups overlap on the GPU and the split between them is approximate.
+
+ The results of an image are read when its fence has already been waited for, i.e. when the image comes
+ round again (a frame late or more), without waiting: queries that were never written in that
+ submission (a group with no draws) are just reported missing. Devices without timestamps on the graphics
+ queue (timestampPeriod or timestampValidBits of 0) keep the timer off: every call is then a no-op.
+ */
+
+const uint32_t GPU_TIMER_SCENE_BEGIN = 0;
+const uint32_t GPU_TIMER_SCENE_END = 1;
+const uint32_t GPU_TIMER_UI_BEGIN = 2;
+const uint32_t GPU_TIMER_UI_END = 3;
+const uint32_t GPU_TIMER_FIRST_GROUP_QUERY = 4;
+
+// GPU time of one pass or pipeline group in the last frame read back
+struct GpuTimerSection {
+    std::string name;       // "gpu scene", "gpu ui", "gpu <group>"
+    double ms = 0.0;
+    bool valid = false;     // false if its timestamps were not written in that frame
+};
+
+class GpuTimer {
+
+    VkDevice device = VK_NULL_HANDLE;
+    bool supported = false;
+    double nsPerTick = 0.0;
+    uint64_t validMask = 0;
+
+    std::vector<std::string> groupNames;
+    uint32_t chunkSlots = 1;
+    uint32_t queryCount = 0;
+
+    std::vector<VkQueryPool> pools;         // one per swap chain image
+    std::vector<bool> pending;              // submitted and not read back yet
+    std::vector<int64_t> submitNs;          // Profiler::now() at the submission, to place the GPU track
+
+    std::vector<GpuTimerSection> sections;  // scene, ui, then the groups
+    std::vector<uint64_t> results;          // (timestamp, availability) pairs
+    ProfilerRing* track = nullptr;
+
+    uint32_t groupQuery(unsigned chunk, int group) const {
+        return GPU_TIMER_FIRST_GROUP_QUERY + 2 * (chunk * (uint32_t)groupNames.size() + (uint32_t)group);
+    }
+
+    bool available(uint32_t query) const {
+        return results[2 * query + 1] != 0;
+    }
+
+    uint64_t ticks(uint32_t query) const {
+        return results[2 * query] & validMask;
+    }
+
+    // ticks between two queries; false, with a delta of 0, if either was not written
+    bool elapsed(uint32_t begin, uint32_t end, uint64_t& delta) const {
+        delta = 0;
+        if (!available(begin) || !available(end)) return false;
+        delta = (ticks(end) - ticks(begin)) & validMask;
+        return true;
+    }
+
+    int64_t toNs(uint64_t delta) const {
+        return (int64_t)(delta * nsPerTick);
+    }
+
+    void write(VkCommandBuffer commandBuffer, size_t image, uint32_t query, VkPipelineStageFlagBits stage) const {
+        if (!supported || image >= pools.size()) return;
+        vkCmdWriteTimestamp(commandBuffer, stage, pools[image], query);
+    }
+
+    // a trace event on the "GPU" track, at its offset from the start of the scene pass
+    void trace(size_t image, const char* name, uint32_t begin, uint32_t end, uint32_t depth) const {
+        uint64_t delta = 0;
+        uint64_t offset = 0;
+        if (!elapsed(begin, end, delta) || !elapsed(GPU_TIMER_SCENE_BEGIN, begin, offset)) return;
+        int64_t startNs = submitNs[image] + toNs(offset);
+        Profiler::record(*track, name, startNs, startNs + toNs(delta), depth);
+    }
+
+public:
+
+    // groupNames: the pipeline groups, by index; chunkSlots: the most chunks a scene is recorded in
+    void init(VkDevice _device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+              const std::vector<std::string>& _groupNames, uint32_t _chunkSlots) {
+        device = _device;
+        groupNames = _groupNames;
+        chunkSlots = std::max(1u, _chunkSlots);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+        uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+        if (properties.limits.timestampPeriod == 0.0f || validBits == 0) {
+            std::cout << "GPU timer: no timestamps on the graphics queue, GPU timings disabled\n";
+            return;
+        }
+        supported = true;
+        nsPerTick = properties.limits.timestampPeriod;
+        validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        queryCount = GPU_TIMER_FIRST_GROUP_QUERY + 2 * chunkSlots * (uint32_t)groupNames.size();
+        results.resize(2 * queryCount);
+
+        sections.push_back({"gpu scene"});
+        sections.push_back({"gpu ui"});
+        for (const std::string& group : groupNames) {
+            sections.push_back({"gpu " + group});
+        }
+        std::cout << "GPU timer: " << queryCount << " timestamps per frame, " << nsPerTick << " ns per tick\n";
+    }
+
+    bool isEnabled() const {
+        return supported;
+    }
+
+    // creates the query pools of new images; existing pools (and their pending results) are kept
+    void prepare(size_t imageCount) {
+        if (!supported) return;
+        while (pools.size() < imageCount) {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = queryCount;
+            VkQueryPool pool;
+            if (vkCreateQueryPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+            pools.push_back(pool);
+            pending.push_back(false);
+            submitNs.push_back(0);
+        }
+    }
+
+    // outside any render pass, before the other queries of the image in the same submission
+    void reset(VkCommandBuffer commandBuffer, size_t image) const {
+        if (!supported || image >= pools.size()) return;
+        vkCmdResetQueryPool(commandBuffer, pools[image], 0, queryCount);
+    }
+
+    void beginScene(VkCommandBuffer commandBuffer, size_t image) const {
+        write(commandBuffer, image, GPU_TIMER_SCENE_BEGIN, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    }
+
+    void endScene(VkCommandBuffer commandBuffer, size_t image) const {
+        write(commandBuffer, image, GPU_TIMER_SCENE_END, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    }
+
+    void beginUI(VkCommandBuffer commandBuffer, size_t image) const {
+        write(commandBuffer, image, GPU_TIMER_UI_BEGIN, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    }
+
+    void endUI(VkCommandBuffer commandBuffer, size_t image) const {
+        write(commandBuffer, image, GPU_TIMER_UI_END, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    }
+
+    // a group can be timed at most once per chunk; chunks beyond chunkSlots (benchmark recorders) are not timed
+    void beginGroup(VkCommandBuffer commandBuffer, size_t image, unsigned chunk, int group) const {
+        if (chunk >= chunkSlots || group < 0 || group >= (int)groupNames.size()) return;
+        write(commandBuffer, image, groupQuery(chunk, group), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    }
+
+    void endGroup(VkCommandBuffer commandBuffer, size_t image, unsigned chunk, int group) const {
+        if (chunk >= chunkSlots || group < 0 || group >= (int)groupNames.size()) return;
+        write(commandBuffer, image, groupQuery(chunk, group) + 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    }
+
+    // the command buffers of the image have been submitted
+    void submitted(size_t image) {
+        if (!supported || image >= pools.size()) return;
+        pending[image] = true;
+        submitNs[image] = Profiler::now();
+    }
+
+    // the caller must have waited for the fence of the image's last submission; true if new timings were read
+    bool collect(size_t image) {
+        if (!supported || image >= pools.size() || !pending[image]) return false;
+        pending[image] = false;
+
+        // without WAIT: VK_NOT_READY only tells that some queries were not written (their availability is 0)
+        VkResult result = vkGetQueryPoolResults(device, pools[image], 0, queryCount, results.size() * sizeof(uint64_t),
+                                                results.data(), 2 * sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS && result != VK_NOT_READY) return false;
+
+        uint64_t delta = 0;
+        sections[0].valid = elapsed(GPU_TIMER_SCENE_BEGIN, GPU_TIMER_SCENE_END, delta);
+        sections[0].ms = sections[0].valid ? toNs(delta) / 1e6 : 0.0;
+        sections[1].valid = elapsed(GPU_TIMER_UI_BEGIN, GPU_TIMER_UI_END, delta);
+        sections[1].ms = sections[1].valid ? toNs(delta) / 1e6 : 0.0;
+        for (size_t group = 0; group < groupNames.size(); group++) {
+            GpuTimerSection& section = sections[2 + group];
+            section.valid = false;
+            section.ms = 0.0;
+            for (unsigned chunk = 0; chunk < chunkSlots; chunk++) {
+                uint32_t query = groupQuery(chunk, (int)group);
+                if (elapsed(query, query + 1, delta)) {
+                    section.valid = true;
+                    section.ms += toNs(delta) / 1e6;
+                }
+            }
+        }
+
+        if (Profiler::isEnabled()) {
+            if (track == nullptr) track = &Profiler::track("GPU");
+            trace(image, sections[0].name.c_str(), GPU_TIMER_SCENE_BEGIN, GPU_TIMER_SCENE_END, 0);
+            for (unsigned chunk = 0; chunk < chunkSlots; chunk++) {
+                for (size_t group = 0; group < groupNames.size(); group++) {
+                    uint32_t query = groupQuery(chunk, (int)group);
+                    trace(image, sections[2 + group].name.c_str(), query, query + 1, 1);
+                }
+            }
+            trace(image, sections[1].name.c_str(), GPU_TIMER_UI_BEGIN, GPU_TIMER_UI_END, 0);
+        }
+        return true;
+    }
+
+    // timings of the last frame read back by collect
+    const std::vector<GpuTimerSection>& getSections() const {
+        return sections;
+    }
+
+    void cleanup() {
+        for (VkQueryPool pool : pools) {
+            vkDestroyQueryPool(device, pool, nullptr);
+        }
+        pools.clear();
+        pending.clear();
+        submitNs.clear();
+    }
+};
+
+#endif
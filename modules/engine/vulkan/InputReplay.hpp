@@ -0,0 +1,305 @@
+#ifndef INPUT_REPLAY_HPP
+#define INPUT_REPLAY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+/*
+ Deterministic input replay, for benchmarks that can be compared run to run.
+ Recording (--record-input file) stores, for every frame, what getSixAxis produced (the delta time,
+ the car movement and camera rotation vectors, gamepad sticks included) and the keys that were found
+ pressed through BaseProject::isKeyPressed, together with the seed of the scene's random numbers:
+
+    {"version": 1, "seed": 1234, "frames": [{"dt": 0.016, "move": [0, 0, -1], "rotate": [0, 0, 0], "keys": [32]}, ...]}
+
+ Playback (--replay file) feeds the frames back in order instead of reading GLFW, with EngineDeltaTime
+ fixed to the replay timestep rather than the recorded one, so the simulation no longer depends on how
+ fast the frames are rendered: two playbacks of the same recording on the same build run the same race.
+ While playing, the CPU time of every manager update and of the whole frame is collected and written,
+ when the recording runs out, as a JSON report with the per-frame times and their min, median, p99 and
+ max; the render counters of each frame (see RenderStats) are summarised the same way. The gamepad buttons (which emit their signals directly) are not recorded.
+ */
+
+const int INPUT_REPLAY_VERSION = 1;
+const double INPUT_REPLAY_DEFAULT_TIMESTEP = 1.0 / 60.0;
+
+struct InputReplayFrame {
+    float deltaTime = 0.0f;
+    glm::vec3 carMovement = glm::vec3(0.0f);
+    glm::vec3 cameraRotation = glm::vec3(0.0f);
+    std::vector<int> keys;              // the keys found pressed during the frame
+};
+
+// per-frame value of one timed section (a manager, or the whole frame, in ms) or of one counter
+struct InputReplaySection {
+    std::string name;
+    std::vector<double> ms;
+};
+
+class InputReplay {
+
+    enum Mode { OFF, RECORDING, PLAYING };
+
+    Mode mode = OFF;
+    std::string path;
+    std::string reportPath;
+    double timestep = INPUT_REPLAY_DEFAULT_TIMESTEP;   // <= 0 plays the recorded delta times back
+    uint32_t seed = 0;
+
+    std::vector<InputReplayFrame> frames;
+    size_t cursor = 0;                  // frame being played
+    bool started = false;               // playback: a frame is being played
+    bool finished = false;
+
+    std::vector<InputReplaySection> sections;
+    std::vector<InputReplaySection> counts;
+    size_t timedFrames = 0;
+
+    static nlohmann::json toJson(const glm::vec3& v) {
+        return nlohmann::json::array({v.x, v.y, v.z});
+    }
+
+    static bool isVec3(const nlohmann::json& js) {
+        return js.is_array() && js.size() == 3 && js[0].is_number() && js[1].is_number() && js[2].is_number();
+    }
+
+    static glm::vec3 vec3FromJson(const nlohmann::json& js) {
+        return glm::vec3(js[0].get<float>(), js[1].get<float>(), js[2].get<float>());
+    }
+
+    // nearest-rank percentile of sorted values
+    static double percentile(const std::vector<double>& sorted, double p) {
+        size_t rank = (size_t)std::ceil(p * sorted.size());
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    // json is built with JSON_NOEXCEPTION (see Starter.hpp), so the file is checked instead of relying on throws
+    void load() {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open input recording " + path);
+        }
+        nlohmann::json js = nlohmann::json::parse(file, nullptr, false);
+        if (js.is_discarded() || !js.is_object() || !js.contains("frames") || !js["frames"].is_array() ||
+            !js.contains("seed") || !js["seed"].is_number_unsigned()) {
+            throw std::runtime_error("invalid input recording " + path);
+        }
+        if (!js.contains("version") || js["version"] != INPUT_REPLAY_VERSION) {
+            throw std::runtime_error("unsupported input recording version in " + path);
+        }
+        seed = js["seed"].get<uint32_t>();
+        for (const nlohmann::json& f : js["frames"]) {
+            if (!f.is_object() || !f.contains("dt") || !f["dt"].is_number() || !f.contains("move") || !isVec3(f["move"]) ||
+                !f.contains("rotate") || !isVec3(f["rotate"]) || !f.contains("keys") || !f["keys"].is_array()) {
+                throw std::runtime_error("invalid frame " + std::to_string(frames.size()) + " in input recording " + path);
+            }
+            InputReplayFrame frame;
+            frame.deltaTime = f["dt"].get<float>();
+            frame.carMovement = vec3FromJson(f["move"]);
+            frame.cameraRotation = vec3FromJson(f["rotate"]);
+            for (const nlohmann::json& key : f["keys"]) {
+                if (key.is_number_integer()) frame.keys.push_back(key.get<int>());
+            }
+            frames.push_back(frame);
+        }
+        std::cout << "Input replay: " << frames.size() << " frames from " << path << ", timestep "
+                  << (timestep > 0.0 ? std::to_string(timestep) + " s" : std::string("as recorded")) << "\n";
+    }
+
+    void saveRecording() const {
+        nlohmann::json js;
+        js["version"] = INPUT_REPLAY_VERSION;
+        js["seed"] = seed;
+        js["frames"] = nlohmann::json::array();
+        for (const InputReplayFrame& frame : frames) {
+            js["frames"].push_back({
+                {"dt", frame.deltaTime},
+                {"move", toJson(frame.carMovement)},
+                {"rotate", toJson(frame.cameraRotation)},
+                {"keys", frame.keys}
+            });
+        }
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Input replay: cannot write " << path << std::endl;
+            return;
+        }
+        file << js.dump() << "\n";
+        std::cout << "Input replay: recorded " << frames.size() << " frames to " << path << "\n";
+    }
+
+    // min, median, p99 and max of every section, and their per-frame values
+    static void summarise(const std::vector<InputReplaySection>& list, nlohmann::json& summary, nlohmann::json& perFrame) {
+        summary = nlohmann::json::object();
+        perFrame = nlohmann::json::object();
+        for (const InputReplaySection& section : list) {
+            perFrame[section.name] = section.ms;
+            if (section.ms.empty()) continue;
+            std::vector<double> sorted = section.ms;
+            std::sort(sorted.begin(), sorted.end());
+            summary[section.name] = {
+                {"min", sorted.front()},
+                {"median", percentile(sorted, 0.5)},
+                {"p99", percentile(sorted, 0.99)},
+                {"max", sorted.back()}
+            };
+        }
+    }
+
+    // keys are sorted, so two runs of the same build produce reports that differ only in the timings
+    void saveReport() const {
+        nlohmann::json js;
+        js["recording"] = path;
+        js["frames"] = timedFrames;
+        js["timestep"] = timestep;
+        js["seed"] = seed;
+        summarise(sections, js["summary_ms"], js["per_frame_ms"]);
+        summarise(counts, js["summary_counts"], js["per_frame_counts"]);
+
+        std::ofstream file(reportPath);
+        if (!file.is_open()) {
+            std::cerr << "Input replay: cannot write " << reportPath << std::endl;
+            return;
+        }
+        file << js.dump(2) << "\n";
+        std::cout << "Input replay: report of " << timedFrames << " frames written to " << reportPath << "\n";
+    }
+
+    static InputReplaySection& section(std::vector<InputReplaySection>& list, const std::string& name) {
+        for (InputReplaySection& s : list) {
+            if (s.name == name) return s;
+        }
+        list.push_back({name, {}});
+        return list.back();
+    }
+
+    void add(std::vector<InputReplaySection>& list, const std::string& name, double value) {
+        if (!isTiming()) return;
+        InputReplaySection& s = section(list, name);
+        s.ms.resize(timedFrames, 0.0);
+        s.ms.push_back(value);
+    }
+
+public:
+
+    void record(const std::string& recordingPath) {
+        mode = RECORDING;
+        path = recordingPath;
+    }
+
+    void play(const std::string& recordingPath, double fixedTimestep, const std::string& report) {
+        mode = PLAYING;
+        path = recordingPath;
+        timestep = fixedTimestep;
+        reportPath = report;
+    }
+
+    bool isRecording() const { return mode == RECORDING; }
+    bool isPlaying() const { return mode == PLAYING; }
+    // true while the frames of a playback are timed
+    bool isTiming() const { return mode == PLAYING && started && !finished; }
+    // playback: the recording has run out
+    bool isFinished() const { return finished; }
+
+    // loads the recording to play, or draws the seed to record; before the scene is initialised
+    void begin() {
+        if (mode == PLAYING) {
+            load();
+        } else {
+            seed = std::random_device{}();
+        }
+    }
+
+    // seed of the scene's random numbers, the recorded one during a playback
+    uint32_t getSeed() const {
+        return seed;
+    }
+
+    // starts a frame: getSixAxis calls it before reading any input
+    void beginFrame() {
+        if (mode == RECORDING) {
+            frames.emplace_back();
+        } else if (mode == PLAYING) {
+            if (started) cursor++;
+            started = true;
+            finished = cursor >= frames.size();
+        }
+    }
+
+    // playback: the frame's delta time and motion, no motion once the recording has run out
+    void playMotion(float& deltaT, glm::vec3& m, glm::vec3& r) const {
+        if (finished) {
+            deltaT = (float)(timestep > 0.0 ? timestep : INPUT_REPLAY_DEFAULT_TIMESTEP);
+            return;
+        }
+        const InputReplayFrame& frame = frames[cursor];
+        deltaT = timestep > 0.0 ? (float)timestep : frame.deltaTime;
+        m = frame.carMovement;
+        r = frame.cameraRotation;
+    }
+
+    // recording: the frame's delta time and motion, as computed from the live input
+    void recordMotion(float deltaT, const glm::vec3& m, const glm::vec3& r) {
+        if (mode != RECORDING || frames.empty()) return;
+        frames.back().deltaTime = deltaT;
+        frames.back().carMovement = m;
+        frames.back().cameraRotation = r;
+    }
+
+    // the key state for this frame: recorded during a playback, else read from the window (if any)
+    bool keyPressed(GLFWwindow* window, int key) {
+        if (mode == PLAYING) {
+            if (finished || !started) return false;
+            const std::vector<int>& keys = frames[cursor].keys;
+            return std::find(keys.begin(), keys.end(), key) != keys.end();
+        }
+        bool pressed = window != nullptr && glfwGetKey(window, key) == GLFW_PRESS;
+        if (pressed && mode == RECORDING && !frames.empty()) {
+            std::vector<int>& keys = frames.back().keys;
+            if (std::find(keys.begin(), keys.end(), key) == keys.end()) keys.push_back(key);
+        }
+        return pressed;
+    }
+
+    // CPU time of one section of the current frame (only kept while timing)
+    void addTime(const std::string& name, double ms) {
+        add(sections, name, ms);
+    }
+
+    // a render counter of the current frame (only kept while timing)
+    void addCount(const std::string& name, double value) {
+        add(counts, name, value);
+    }
+
+    // closes the timings of the current frame with its total CPU time
+    void endFrame(double frameMs) {
+        if (!isTiming()) return;
+        addTime("frame", frameMs);
+        timedFrames++;
+        for (InputReplaySection& s : sections) {
+            s.ms.resize(timedFrames, 0.0);
+        }
+        for (InputReplaySection& s : counts) {
+            s.ms.resize(timedFrames, 0.0);
+        }
+    }
+
+    // writes the recording, or the report of the playback
+    void end() {
+        if (mode == RECORDING) {
+            saveRecording();
+        } else if (mode == PLAYING) {
+            saveReport();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef MEMORY_ALLOCATOR_HPP
+#define MEMORY_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+/*
+ Device memory suballocator.
+ Instead of one vkAllocateMemory per buffer or image, memory is taken from large blocks (one list of
+ blocks per memory type) and handed out as (VkDeviceMemory, offset) ranges:
+    - every block keeps a free list of ranges sorted by offset, allocation is first-fit with the
+      offset rounded up to the resource alignment, freed ranges are merged with their neighbours;
+    - buffers (linear) and images (optimal tiling) never share a block, so bufferImageGranularity
+      never has to be taken into account;
+    - resources bigger than half a block get a dedicated block of their own size, released as soon
+      as they are freed;
+    - host visible blocks are mapped once, when they are created, and stay mapped until destroyed:
+      allocations carry a pointer into the mapping, so writes are a plain memcpy (followed by flush(),
+      which only reaches the driver for non coherent memory).
+ Not thread safe: allocate and free from the thread that owns the Vulkan device (the loading thread).
+ */
+
+const VkDeviceSize MEMORY_ALLOCATOR_BLOCK_SIZE = 64 * 1024 * 1024;
+
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;             // only for host visible memory
+    int blockIndex = -1;
+};
+
+struct MemoryAllocatorStats {
+    size_t blockCount = 0;
+    size_t allocationCount = 0;
+    VkDeviceSize bytesReserved = 0;     // total size of the blocks obtained from the driver
+    VkDeviceSize bytesInUse = 0;        // sum of the live allocations (alignment padding included)
+    VkDeviceSize largestFreeRange = 0;
+    float fragmentation = 0.0f;         // 1 - sum of the largest free range of each shared block / total free bytes
+};
+
+class MemoryAllocator {
+
+    struct FreeRange {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        bool linear = true;
+        bool dedicated = false;
+        bool coherent = true;
+        void* mapped = nullptr;
+        VkDeviceSize used = 0;
+        size_t allocations = 0;
+        std::vector<FreeRange> freeRanges;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize nonCoherentAtomSize = 1;
+    VkDeviceSize blockSize = MEMORY_ALLOCATOR_BLOCK_SIZE;
+    std::vector<Block> blocks;
+    std::vector<int> unusedBlockSlots;
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) &&
+                (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    int createBlock(VkDeviceSize size, uint32_t memoryType, bool linear, bool dedicated) {
+        Block block;
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+        VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &block.memory);
+        if (result != VK_SUCCESS) {
+            std::cout << "Error: " << result << " while allocating a " << size << " bytes memory block\n";
+            throw std::runtime_error("failed to allocate device memory block!");
+        }
+        block.size = size;
+        block.memoryType = memoryType;
+        block.linear = linear;
+        block.dedicated = dedicated;
+        block.freeRanges.push_back({0, size});
+
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+        block.coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            result = vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+            if (result != VK_SUCCESS) {
+                vkFreeMemory(device, block.memory, nullptr);
+                std::cout << "Error: " << result << " while mapping a " << size << " bytes memory block\n";
+                throw std::runtime_error("failed to map device memory block!");
+            }
+        }
+
+        if (!unusedBlockSlots.empty()) {
+            int slot = unusedBlockSlots.back();
+            unusedBlockSlots.pop_back();
+            blocks[slot] = std::move(block);
+            return slot;
+        }
+        blocks.push_back(std::move(block));
+        return (int)blocks.size() - 1;
+    }
+
+    bool allocateFromBlock(int blockIndex, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation) {
+        Block& block = blocks[blockIndex];
+        for (size_t i = 0; i < block.freeRanges.size(); i++) {
+            FreeRange range = block.freeRanges[i];
+            VkDeviceSize offset = alignUp(range.offset, alignment);
+            VkDeviceSize end = offset + size;
+            if (end > range.offset + range.size) continue;
+
+            // the alignment padding in front stays free, the tail goes back to the list
+            std::vector<FreeRange> replacement;
+            if (offset > range.offset) replacement.push_back({range.offset, offset - range.offset});
+            if (end < range.offset + range.size) replacement.push_back({end, range.offset + range.size - end});
+            block.freeRanges.erase(block.freeRanges.begin() + i);
+            block.freeRanges.insert(block.freeRanges.begin() + i, replacement.begin(), replacement.end());
+
+            block.used += size;
+            block.allocations++;
+            allocation.memory = block.memory;
+            allocation.offset = offset;
+            allocation.size = size;
+            allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+            allocation.blockIndex = blockIndex;
+            return true;
+        }
+        return false;
+    }
+
+    void destroyBlock(int blockIndex) {
+        if (blocks[blockIndex].mapped) vkUnmapMemory(device, blocks[blockIndex].memory);
+        vkFreeMemory(device, blocks[blockIndex].memory, nullptr);
+        blocks[blockIndex] = Block();
+        unusedBlockSlots.push_back(blockIndex);
+    }
+
+public:
+
+    void init(VkDevice dev, VkPhysicalDevice physicalDevice, VkDeviceSize sharedBlockSize = MEMORY_ALLOCATOR_BLOCK_SIZE) {
+        device = dev;
+        blockSize = sharedBlockSize;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        nonCoherentAtomSize = std::max<VkDeviceSize>(1, properties.limits.nonCoherentAtomSize);
+    }
+
+    // linear = true for buffers, false for optimal tiling images
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear) {
+        uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+        MemoryAllocation allocation;
+
+        if (requirements.size > blockSize / 2) {
+            int blockIndex = createBlock(requirements.size, memoryType, linear, true);
+            allocateFromBlock(blockIndex, requirements.size, requirements.alignment, allocation);
+            return allocation;
+        }
+
+        for (int b = 0; b < (int)blocks.size(); b++) {
+            const Block& block = blocks[b];
+            if (block.memory == VK_NULL_HANDLE || block.dedicated ||
+                block.memoryType != memoryType || block.linear != linear) continue;
+            if (allocateFromBlock(b, requirements.size, requirements.alignment, allocation)) {
+                return allocation;
+            }
+        }
+
+        int blockIndex = createBlock(blockSize, memoryType, linear, false);
+        allocateFromBlock(blockIndex, requirements.size, requirements.alignment, allocation);
+        return allocation;
+    }
+
+    void free(MemoryAllocation& allocation) {
+        if (allocation.blockIndex < 0) return;
+
+        Block& block = blocks[allocation.blockIndex];
+        block.used -= allocation.size;
+        block.allocations--;
+
+        if (block.dedicated) {
+            destroyBlock(allocation.blockIndex);
+        } else {
+            // insert in offset order, then merge with the previous and next ranges when they touch
+            auto it = std::lower_bound(block.freeRanges.begin(), block.freeRanges.end(), allocation.offset,
+                                       [](const FreeRange& r, VkDeviceSize offset) { return r.offset < offset; });
+            it = block.freeRanges.insert(it, {allocation.offset, allocation.size});
+            if (it + 1 != block.freeRanges.end() && it->offset + it->size == (it + 1)->offset) {
+                it->size += (it + 1)->size;
+                block.freeRanges.erase(it + 1);
+            }
+            if (it != block.freeRanges.begin() && (it - 1)->offset + (it - 1)->size == it->offset) {
+                (it - 1)->size += it->size;
+                block.freeRanges.erase(it);
+            }
+        }
+
+        allocation = MemoryAllocation();
+    }
+
+    // Makes host writes to [offset, offset + size) of the allocation visible to the device.
+    // Nothing to do for coherent memory; otherwise the range is widened to nonCoherentAtomSize.
+    void flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const {
+        if (allocation.blockIndex < 0) return;
+        const Block& block = blocks[allocation.blockIndex];
+        if (block.coherent) return;
+
+        if (size == VK_WHOLE_SIZE) size = allocation.size - offset;
+        VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+        VkDeviceSize end = std::min(alignUp(allocation.offset + offset + size, nonCoherentAtomSize), block.size);
+
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = block.memory;
+        range.offset = begin;
+        range.size = end - begin;
+        vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+
+    MemoryAllocatorStats getStats() const {
+        MemoryAllocatorStats stats;
+        VkDeviceSize totalFree = 0;
+        VkDeviceSize largestSum = 0;
+        for (const Block& block : blocks) {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            stats.blockCount++;
+            stats.allocationCount += block.allocations;
+            stats.bytesReserved += block.size;
+            stats.bytesInUse += block.used;
+            if (block.dedicated) continue;
+            VkDeviceSize blockLargest = 0;
+            for (const FreeRange& range : block.freeRanges) {
+                totalFree += range.size;
+                blockLargest = std::max(blockLargest, range.size);
+            }
+            largestSum += blockLargest;
+            stats.largestFreeRange = std::max(stats.largestFreeRange, blockLargest);
+        }
+        stats.fragmentation = totalFree > 0 ? 1.0f - (float)largestSum / (float)totalFree : 0.0f;
+        return stats;
+    }
+
+    void printStats() const {
+        MemoryAllocatorStats stats = getStats();
+        std::cout << "Device memory: " << stats.allocationCount << " allocations in " << stats.blockCount << " blocks, "
+                  << (stats.bytesInUse / (1024.0 * 1024.0)) << " MB in use of "
+                  << (stats.bytesReserved / (1024.0 * 1024.0)) << " MB reserved, fragmentation "
+                  << (stats.fragmentation * 100.0f) << "%\n";
+    }
+
+    void cleanup() {
+        for (int b = 0; b < (int)blocks.size(); b++) {
+            if (blocks[b].memory == VK_NULL_HANDLE) continue;
+            if (blocks[b].allocations > 0) {
+                std::cout << "Memory allocator: " << blocks[b].allocations << " allocations still alive in block " << b << "\n";
+            }
+            if (blocks[b].mapped) vkUnmapMemory(device, blocks[b].memory);
+            vkFreeMemory(device, blocks[b].memory, nullptr);
+        }
+        blocks.clear();
+        unusedBlockSlots.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ Baked mesh cache.
+ Every model is stored as a flat binary file under cache/meshes, so that the next launch can skip
+ tinyobj / tinygltf parsing (and AES + inflate for .mgcg files). The file layout is:
+
+    MeshCacheHeader | vertex bytes (vertexCount * stride) | indices (indexCount * uint32)
+
+ Every section starts at a 16-byte aligned offset, and the vertex bytes are already laid out for
+ the VertexDescriptor stride: loading is two reads straight into the vertex and index vectors, with no
+ parsing or conversion.
+ A cache entry is considered fresh only if version, stride, vertex layout and source size match, and
+ either the source modification time matches or, when it does not (a checkout, a copy), the source
+ hash does; only then is the source read and hashed, and the entry takes the new time.
+ The counts and offsets of the header are checked against the file size, and the indices against the
+ vertex count, so a truncated or damaged entry is rebuilt from the source like a stale one.
+ */
+
+const uint32_t MESH_CACHE_MAGIC = 0x4843474D; // "MGCH"
+const uint32_t MESH_CACHE_VERSION = 3; // 2: deduplicated and cache-optimized meshes, 3: source time
+const std::string MESH_CACHE_DIRECTORY = "cache/meshes";
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stride;
+    uint32_t reserved;
+    uint64_t layoutHash;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    int64_t sourceTime;     // last write time of the source, in file clock ticks
+};
+
+static_assert(sizeof(MeshCacheHeader) % 16 == 0, "MeshCacheHeader must keep the sections 16-byte aligned");
+
+// Identifies the cache entry of a source file, as computed before loading it (the hash only when needed)
+struct MeshCacheKey {
+    bool valid = false;
+    std::string sourceFile;
+    std::string cachePath;
+    uint32_t stride = 0;
+    uint64_t layoutHash = 0;
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    bool hashed = false;
+    uint64_t sourceHash = 0;
+};
+
+class MeshCache {
+
+    static uint64_t alignTo16(uint64_t value) {
+        return (value + 15) & ~uint64_t(15);
+    }
+
+public:
+
+    static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+    static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+    // FNV-1a 64 bit
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = FNV_OFFSET) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t h = seed;
+        for (size_t i = 0; i < size; i++) {
+            h ^= bytes[i];
+            h *= FNV_PRIME;
+        }
+        return h;
+    }
+
+    // models/track.mgcg -> cache/meshes/models_track.mgcg.mesh
+    static std::string pathFor(const std::string& sourceFile) {
+        std::string name = sourceFile;
+        for (char& c : name) {
+            if (c == '/' || c == '\\' || c == ':') c = '_';
+        }
+        return MESH_CACHE_DIRECTORY + "/" + name + ".mesh";
+    }
+
+    // Size and modification time of the source file; the returned key is invalid if the source cannot be found
+    static MeshCacheKey makeKey(const std::string& sourceFile, uint32_t stride, uint64_t layoutHash) {
+        MeshCacheKey key;
+        key.sourceFile = sourceFile;
+        key.cachePath = pathFor(sourceFile);
+        key.stride = stride;
+        key.layoutHash = layoutHash;
+
+        std::error_code ec;
+        uint64_t fileSize = std::filesystem::file_size(sourceFile, ec);
+        if (ec) return key;
+        std::filesystem::file_time_type time = std::filesystem::last_write_time(sourceFile, ec);
+        if (ec) return key;
+
+        key.sourceSize = fileSize;
+        key.sourceTime = (int64_t)time.time_since_epoch().count();
+        key.valid = true;
+        return key;
+    }
+
+    // Reads and hashes the source file, once per key; false if it cannot be read
+    static bool hashSource(MeshCacheKey& key) {
+        if (key.hashed) return true;
+        std::ifstream file(key.sourceFile, std::ios::binary);
+        if (!file.is_open()) return false;
+        std::vector<char> buffer(key.sourceSize);
+        if (!file.read(buffer.data(), buffer.size())) return false;
+
+        key.sourceHash = hash(buffer.data(), buffer.size());
+        key.hashed = true;
+        return true;
+    }
+
+    // Returns false (leaving the outputs untouched) if the entry is missing, stale or damaged
+    static bool load(MeshCacheKey& key, std::vector<unsigned char>& vertices, std::vector<uint32_t>& indices) {
+        if (!key.valid) return false;
+
+        std::ifstream file(key.cachePath, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        MeshCacheHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+        if (header.magic != MESH_CACHE_MAGIC ||
+            header.version != MESH_CACHE_VERSION ||
+            header.stride != key.stride ||
+            header.layoutHash != key.layoutHash ||
+            header.sourceSize != key.sourceSize) {
+            return false;
+        }
+        // same size, another time: still fresh if the contents did not change
+        bool touched = header.sourceTime != key.sourceTime;
+        if (touched && (!hashSource(key) || header.sourceHash != key.sourceHash)) {
+            return false;
+        }
+
+        // nothing is allocated from the header before it is known to fit in the file
+        std::error_code ec;
+        uint64_t fileSize = std::filesystem::file_size(key.cachePath, ec);
+        if (ec || header.stride == 0 ||
+            header.vertexOffset < sizeof(header) || header.vertexOffset > fileSize ||
+            header.indexOffset < header.vertexOffset || header.indexOffset > fileSize ||
+            header.vertexCount > (header.indexOffset - header.vertexOffset) / header.stride ||
+            header.indexCount > (fileSize - header.indexOffset) / sizeof(uint32_t)) {
+            return false;
+        }
+
+        std::vector<unsigned char> cachedVertices(header.vertexCount * header.stride);
+        std::vector<uint32_t> cachedIndices(header.indexCount);
+
+        file.seekg(header.vertexOffset);
+        if (!file.read(reinterpret_cast<char*>(cachedVertices.data()), cachedVertices.size())) return false;
+        file.seekg(header.indexOffset);
+        if (!file.read(reinterpret_cast<char*>(cachedIndices.data()), cachedIndices.size() * sizeof(uint32_t))) return false;
+        for (uint32_t index : cachedIndices) {
+            if (index >= header.vertexCount) return false;
+        }
+
+        // the entry takes the new time, so the next launch does not hash the source again (best effort)
+        if (touched) {
+            file.close();
+            header.sourceTime = key.sourceTime;
+            std::fstream update(key.cachePath, std::ios::binary | std::ios::in | std::ios::out);
+            update.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+
+        vertices.swap(cachedVertices);
+        indices.swap(cachedIndices);
+        return true;
+    }
+
+    // Writes to a temporary file first, so a crash never leaves a truncated entry behind
+    static bool store(MeshCacheKey& key, const std::vector<unsigned char>& vertices, const std::vector<uint32_t>& indices) {
+        if (!key.valid || key.stride == 0 || !hashSource(key)) return false;
+
+        std::error_code ec;
+        std::filesystem::create_directories(MESH_CACHE_DIRECTORY, ec);
+        if (ec) {
+            std::cerr << "Mesh cache: cannot create " << MESH_CACHE_DIRECTORY << ": " << ec.message() << std::endl;
+            return false;
+        }
+
+        MeshCacheHeader header{};
+        header.magic = MESH_CACHE_MAGIC;
+        header.version = MESH_CACHE_VERSION;
+        header.stride = key.stride;
+        header.layoutHash = key.layoutHash;
+        header.sourceSize = key.sourceSize;
+        header.sourceHash = key.sourceHash;
+        header.sourceTime = key.sourceTime;
+        header.vertexCount = vertices.size() / key.stride;
+        header.indexCount = indices.size();
+        header.vertexOffset = alignTo16(sizeof(MeshCacheHeader));
+        header.indexOffset = alignTo16(header.vertexOffset + vertices.size());
+
+        const std::string tmpPath = key.cachePath + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+
+            const char zeros[16] = {};
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(zeros, header.vertexOffset - sizeof(header));
+            file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size());
+            file.write(zeros, header.indexOffset - (header.vertexOffset + vertices.size()));
+            file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+            if (!file) return false;
+        }
+
+        std::filesystem::rename(tmpPath, key.cachePath, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MeshCache.hpp"
+
+/*
+ Offline-quality mesh optimization for indexed triangle lists, run once per model at load time
+ (the result is what ends up in the baked mesh cache):
+    1. deduplicate:        vertices with identical bytes are merged, indices are remapped
+    2. optimizeVertexCache: triangles are reordered for post-transform cache locality (Tipsify,
+                            Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+                            and Reduced Overdraw", 2007)
+    3. optimizeVertexFetch: vertices are reordered by first use, so the vertex fetch walks memory
+                            linearly; unreferenced vertices are dropped
+ */
+
+const uint32_t MESH_OPTIMIZER_CACHE_SIZE = 16;
+
+struct MeshOptimizerStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+};
+
+class MeshOptimizer {
+
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+
+    static uint32_t nextDeadEndVertex(std::vector<uint32_t>& deadEnd, const std::vector<uint32_t>& liveTriangles,
+                                      uint32_t& cursor, uint32_t vertexCount) {
+        while (!deadEnd.empty()) {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[v] > 0) return v;
+        }
+        while (cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) return cursor;
+            cursor++;
+        }
+        return EMPTY;
+    }
+
+public:
+
+    // Average cache miss ratio (transformed vertices per triangle) with a FIFO cache of the given size
+    static float averageCacheMissRatio(const std::vector<uint32_t>& indices, uint32_t vertexCount,
+                                       uint32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE) {
+        if (indices.size() < 3) return 0.0f;
+
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        uint32_t time = cacheSize + 1;
+        size_t misses = 0;
+        for (uint32_t index : indices) {
+            if (time - cacheTime[index] > cacheSize) {
+                cacheTime[index] = time++;
+                misses++;
+            }
+        }
+        return (float)misses / (float)(indices.size() / 3);
+    }
+
+    // Merges byte-identical vertices; returns the new vertex count
+    static size_t deduplicate(std::vector<unsigned char>& vertices, std::vector<uint32_t>& indices, uint32_t stride) {
+        const size_t vertexCount = vertices.size() / stride;
+
+        size_t tableSize = 1;
+        while (tableSize < vertexCount * 2) tableSize <<= 1;
+        std::vector<uint32_t> table(tableSize, EMPTY);
+        std::vector<uint32_t> remap(vertexCount);
+
+        size_t unique = 0;
+        for (size_t v = 0; v < vertexCount; v++) {
+            const unsigned char* vertex = &vertices[v * stride];
+            size_t slot = MeshCache::hash(vertex, stride) & (tableSize - 1);
+            while (table[slot] != EMPTY && memcmp(&vertices[(size_t)table[slot] * stride], vertex, stride) != 0) {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if (table[slot] == EMPTY) {
+                // unique vertices are compacted in place: the destination is never ahead of the source
+                if (unique != v) memcpy(&vertices[unique * stride], vertex, stride);
+                table[slot] = (uint32_t)unique++;
+            }
+            remap[v] = table[slot];
+        }
+
+        vertices.resize(unique * stride);
+        for (uint32_t& index : indices) index = remap[index];
+        return unique;
+    }
+
+    // Tipsify: greedily fans around the vertex that is most likely still in the cache
+    static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount,
+                                    uint32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE) {
+        const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+        if (triangleCount == 0) return;
+
+        // vertex -> triangles adjacency, in CSR form
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (uint32_t index : indices) liveTriangles[index]++;
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+        for (uint32_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) adjacency[fill[indices[3 * t + k]]++] = t;
+        }
+
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        uint32_t time = cacheSize + 1;
+        uint32_t cursor = 0;
+        uint32_t fanning = nextDeadEndVertex(deadEnd, liveTriangles, cursor, vertexCount);
+
+        while (fanning != EMPTY) {
+            candidates.clear();
+            for (uint32_t a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++) {
+                uint32_t t = adjacency[a];
+                if (emitted[t]) continue;
+                for (int k = 0; k < 3; k++) {
+                    uint32_t v = indices[3 * t + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveTriangles[v]--;
+                    if (time - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = time++;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            // pick the candidate that will still be in the cache after fanning it, preferring the oldest
+            uint32_t next = EMPTY;
+            int bestPriority = -1;
+            for (uint32_t v : candidates) {
+                if (liveTriangles[v] == 0) continue;
+                int priority = 0;
+                if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                    priority = (int)(time - cacheTime[v]);
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = v;
+                }
+            }
+            fanning = next != EMPTY ? next : nextDeadEndVertex(deadEnd, liveTriangles, cursor, vertexCount);
+        }
+
+        indices.swap(result);
+    }
+
+    // Renumbers vertices in order of first use and drops unreferenced ones; returns the new vertex count
+    static size_t optimizeVertexFetch(std::vector<unsigned char>& vertices, std::vector<uint32_t>& indices, uint32_t stride) {
+        const size_t vertexCount = vertices.size() / stride;
+        std::vector<uint32_t> remap(vertexCount, EMPTY);
+        std::vector<unsigned char> reordered(vertices.size());
+
+        uint32_t next = 0;
+        for (uint32_t& index : indices) {
+            if (remap[index] == EMPTY) {
+                memcpy(&reordered[(size_t)next * stride], &vertices[(size_t)index * stride], stride);
+                remap[index] = next++;
+            }
+            index = remap[index];
+        }
+
+        reordered.resize((size_t)next * stride);
+        vertices.swap(reordered);
+        return next;
+    }
+
+    static MeshOptimizerStats optimize(std::vector<unsigned char>& vertices, std::vector<uint32_t>& indices, uint32_t stride) {
+        MeshOptimizerStats stats;
+        stats.verticesBefore = vertices.size() / stride;
+        stats.acmrBefore = averageCacheMissRatio(indices, (uint32_t)stats.verticesBefore);
+
+        size_t vertexCount = deduplicate(vertices, indices, stride);
+        optimizeVertexCache(indices, (uint32_t)vertexCount);
+        stats.verticesAfter = optimizeVertexFetch(vertices, indices, stride);
+        stats.acmrAfter = averageCacheMissRatio(indices, (uint32_t)stats.verticesAfter);
+        return stats;
+    }
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef PARALLEL_RECORDER_HPP
+#define PARALLEL_RECORDER_HPP
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "../main/ThreadPool.hpp"
+
+/*
+ Records a draw list into secondary command buffers on worker threads.
+ The list [0, itemCount) is cut into one contiguous chunk per thread (contiguous, so that every chunk
+ keeps the state sorting of the render queue); each chunk is recorded into a secondary command buffer
+ allocated from the command pool of its slot, and the primary only executes the secondaries in order.
+ A slot is used by exactly one task per record() call and record() waits for all of them, so every
+ command pool is only ever touched by one thread at a time, as Vulkan requires.
+ The secondaries are allocated once per swap chain image and slot, and implicitly reset when recorded
+ again (the pools allow resetting single buffers).
+
+ The game records its scene command buffers once per swap chain image (at start and when the swap chain
+ is recreated): the objects change through mapped instance buffers and indirect draw counts, so no frame
+ records anything. The threads therefore shorten those recordings and --record-benchmark, not the
+ per-frame CPU time. --record-every-frame records the scene of every frame again, for what a draw list
+ rebuilt every frame would cost; the replay report then has the time of the "record" step, to compare
+ with and without --record-threads.
+ */
+
+// (secondary command buffer, chunk index, first item, one past the last item)
+using ParallelRecordFunction = std::function<void(VkCommandBuffer, unsigned, size_t, size_t)>;
+
+class ParallelRecorder {
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<VkCommandPool> commandPools;                 // one per slot
+    std::vector<std::vector<VkCommandBuffer>> secondaries;   // [image][slot]
+    std::vector<VkCommandBuffer> recorded;                   // secondaries of the last record() call
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    std::vector<VkFramebuffer> framebuffers;
+
+public:
+
+    // threadCount = 0 sizes the recorder to the machine
+    void init(VkDevice _device, uint32_t queueFamily, unsigned threadCount) {
+        device = _device;
+        pool = std::make_unique<ThreadPool>(threadCount);
+
+        commandPools.resize(pool->size());
+        for (VkCommandPool& commandPool : commandPools) {
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = queueFamily;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("failed to create recording command pool!");
+            }
+        }
+    }
+
+    bool isEnabled() const {
+        return pool != nullptr;
+    }
+
+    unsigned getThreadCount() const {
+        return pool ? pool->size() : 0;
+    }
+
+    // the render pass and framebuffers the secondaries continue; allocates the secondaries of new images
+    void prepare(VkRenderPass _renderPass, const std::vector<VkFramebuffer>& _framebuffers) {
+        renderPass = _renderPass;
+        framebuffers = _framebuffers;
+
+        while (secondaries.size() < framebuffers.size()) {
+            std::vector<VkCommandBuffer> imageSecondaries(commandPools.size());
+            for (size_t slot = 0; slot < commandPools.size(); slot++) {
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = commandPools[slot];
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                allocInfo.commandBufferCount = 1;
+                VkResult result = vkAllocateCommandBuffers(device, &allocInfo, &imageSecondaries[slot]);
+                if (result != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate secondary command buffers!");
+                }
+            }
+            secondaries.push_back(imageSecondaries);
+        }
+    }
+
+    // records the chunks of [0, itemCount) for the given image, returns the secondaries to execute, in order.
+    // The items are spread evenly and there are never more chunks than items, so no chunk is empty and only
+    // the last one ends at itemCount.
+    const std::vector<VkCommandBuffer>& record(size_t image, size_t itemCount, const ParallelRecordFunction& recordChunk) {
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(commandPools.size(), itemCount));
+
+        std::vector<std::future<void>> done;
+        done.reserve(chunkCount);
+        recorded.assign(secondaries[image].begin(), secondaries[image].begin() + chunkCount);
+
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            VkCommandBuffer commandBuffer = recorded[chunk];
+            size_t first = chunk * itemCount / chunkCount;
+            size_t last = (chunk + 1) * itemCount / chunkCount;
+            VkFramebuffer framebuffer = framebuffers[image];
+
+            done.push_back(pool->submit([this, commandBuffer, chunk, first, last, framebuffer, &recordChunk]() {
+                PROFILE_SCOPE("record chunk");
+                VkCommandBufferInheritanceInfo inheritanceInfo{};
+                inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+                inheritanceInfo.renderPass = renderPass;
+                inheritanceInfo.subpass = 0;
+                inheritanceInfo.framebuffer = framebuffer;
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                beginInfo.pInheritanceInfo = &inheritanceInfo;
+                if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to begin recording secondary command buffer!");
+                }
+
+                recordChunk(commandBuffer, (unsigned)chunk, first, last);
+
+                if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to record secondary command buffer!");
+                }
+            }));
+        }
+        // waits for every chunk (the tasks reference recordChunk) before rethrowing the first failure
+        std::exception_ptr error;
+        for (std::future<void>& chunk : done) {
+            try {
+                chunk.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+        return recorded;
+    }
+
+    void cleanup() {
+        pool.reset();
+        for (VkCommandPool commandPool : commandPools) {
+            // destroying the pool frees its command buffers
+            vkDestroyCommandPool(device, commandPool, nullptr);
+        }
+        commandPools.clear();
+        secondaries.clear();
+        recorded.clear();
+    }
+};
+
+#endif
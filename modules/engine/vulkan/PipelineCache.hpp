@@ -0,0 +1,210 @@
+#ifndef PIPELINE_CACHE_HPP
+#define PIPELINE_CACHE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MeshCache.hpp"
+
+/*
+ On-disk VkPipelineCache shared by every Pipeline.
+ The driver blob is loaded at initVulkan and written back at cleanup, as cache/pipelines.bin:
+
+    PipelineCacheFileHeader | driver blob (dataSize bytes)
+
+ Our header pins the blob to the device that produced it (vendor, device, driver version and the
+ pipelineCacheUUID) and carries its size and hash (FNV-1a, as the mesh cache), so that a cache copied from another machine, left
+ behind by a driver update or truncated on disk is ignored and the pipelines are built from scratch.
+ The blob's own VkPipelineCacheHeaderVersionOne is checked against the same values before it is
+ handed to the driver.
+ */
+
+const uint32_t PIPELINE_CACHE_MAGIC = 0x50434750; // "PGCP"
+const uint32_t PIPELINE_CACHE_VERSION = 1;
+const std::string PIPELINE_CACHE_DIRECTORY = "cache";
+const std::string PIPELINE_CACHE_PATH = PIPELINE_CACHE_DIRECTORY + "/pipelines.bin";
+
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint32_t reserved;
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+class PipelineCache {
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    bool enabled = true;
+    bool loadedFromDisk = false;
+
+    // pipeline creations since the last printCreationStats
+    int creations = 0;
+    double creationMs = 0.0;
+
+    bool matchesDevice(const PipelineCacheFileHeader& header) const {
+        return header.vendorID == properties.vendorID &&
+               header.deviceID == properties.deviceID &&
+               header.driverVersion == properties.driverVersion &&
+               memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    // Returns an empty blob if the file is missing, corrupted or was written for another device / driver
+    std::vector<char> readBlob() const {
+        std::ifstream file(PIPELINE_CACHE_PATH, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return {};
+        uint64_t fileSize = (uint64_t)file.tellg();
+        file.seekg(0);
+
+        PipelineCacheFileHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return {};
+        if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_VERSION) {
+            std::cout << "Pipeline cache: unknown file format, ignored\n";
+            return {};
+        }
+        if (!matchesDevice(header)) {
+            std::cout << "Pipeline cache: written for another device or driver, ignored\n";
+            return {};
+        }
+
+        if (header.dataSize != fileSize - sizeof(header)) {
+            std::cout << "Pipeline cache: truncated or corrupted, ignored\n";
+            return {};
+        }
+        std::vector<char> blob(header.dataSize);
+        if (!file.read(blob.data(), blob.size()) || MeshCache::hash(blob.data(), blob.size()) != header.dataHash) {
+            std::cout << "Pipeline cache: truncated or corrupted, ignored\n";
+            return {};
+        }
+
+        VkPipelineCacheHeaderVersionOne driverHeader{};
+        if (blob.size() < sizeof(driverHeader)) return {};
+        memcpy(&driverHeader, blob.data(), sizeof(driverHeader));
+        if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            driverHeader.vendorID != properties.vendorID ||
+            driverHeader.deviceID != properties.deviceID ||
+            memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "Pipeline cache: driver header mismatch, ignored\n";
+            return {};
+        }
+        return blob;
+    }
+
+public:
+
+    // without the cache (enabled = false) every pipeline is compiled from scratch, to measure the difference
+    void init(VkDevice _device, VkPhysicalDevice physicalDevice, bool _enabled = true) {
+        device = _device;
+        enabled = _enabled;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if (!enabled) {
+            std::cout << "Pipeline cache: disabled\n";
+            return;
+        }
+
+        std::vector<char> blob = readBlob();
+        loadedFromDisk = !blob.empty();
+
+        VkPipelineCacheCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = blob.size();
+        createInfo.pInitialData = blob.empty() ? nullptr : blob.data();
+
+        VkResult result = vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+        if (result != VK_SUCCESS && loadedFromDisk) {
+            // the driver can still refuse data that passed our checks: start empty
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            loadedFromDisk = false;
+            result = vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        std::cout << "Pipeline cache: " << (loadedFromDisk ? "loaded " + std::to_string(blob.size()) + " bytes from " + PIPELINE_CACHE_PATH : std::string("empty")) << "\n";
+    }
+
+    // VK_NULL_HANDLE when disabled, which vkCreateGraphicsPipelines accepts
+    VkPipelineCache get() const {
+        return cache;
+    }
+
+    void recordCreation(double ms) {
+        creations++;
+        creationMs += ms;
+    }
+
+    void printCreationStats(const std::string& when) {
+        if (creations == 0) return;
+        std::cout << "Pipelines (" << when << "): " << creations << " created in " << creationMs << " ms, "
+                  << (!enabled ? "no cache" : (loadedFromDisk ? "cache from disk" : "cold cache")) << "\n";
+        creations = 0;
+        creationMs = 0.0;
+    }
+
+    // Writes to a temporary file first, so a crash never leaves a truncated cache behind
+    bool save() const {
+        if (cache == VK_NULL_HANDLE) return false;
+
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) return false;
+        std::vector<char> blob(size);
+        if (vkGetPipelineCacheData(device, cache, &size, blob.data()) != VK_SUCCESS) return false;
+        blob.resize(size);
+
+        std::error_code ec;
+        std::filesystem::create_directories(PIPELINE_CACHE_DIRECTORY, ec);
+        if (ec) {
+            std::cerr << "Pipeline cache: cannot create " << PIPELINE_CACHE_DIRECTORY << ": " << ec.message() << std::endl;
+            return false;
+        }
+
+        PipelineCacheFileHeader header{};
+        header.magic = PIPELINE_CACHE_MAGIC;
+        header.version = PIPELINE_CACHE_VERSION;
+        header.vendorID = properties.vendorID;
+        header.deviceID = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.dataSize = blob.size();
+        header.dataHash = MeshCache::hash(blob.data(), blob.size());
+
+        const std::string tmpPath = PIPELINE_CACHE_PATH + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(blob.data(), blob.size());
+            if (!file) return false;
+        }
+
+        std::filesystem::rename(tmpPath, PIPELINE_CACHE_PATH, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        std::cout << "Pipeline cache: saved " << blob.size() << " bytes to " << PIPELINE_CACHE_PATH << "\n";
+        return true;
+    }
+
+    void cleanup() {
+        if (cache != VK_NULL_HANDLE) {
+            vkDestroyPipelineCache(device, cache, nullptr);
+            cache = VK_NULL_HANDLE;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef RENDER_STATS_HPP
+#define RENDER_STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+ Per-frame render counters and their rolling history.
+ Command buffers are recorded once and submitted many times, so the binds and draw calls of a frame are
+ the ones counted when the command buffers it submits were recorded: every recorder adds what it recorded
+ (addRecorded) between beginRecording and the end of the recording, which keeps them per swap chain image.
+ Triangles, bytes written through DescriptorSet::map (the global uniforms and the instance storage buffers)
+ and buffers created or destroyed are counted as they happen (from any thread) and go to the frame that
+ calls endFrame next. The draw list counters are set by the draw manager once per frame. The last
+ RENDER_STATS_HISTORY frames are kept for the overlay and the benchmarks.
+ */
+
+const size_t RENDER_STATS_HISTORY = 600;
+
+// Bind and draw commands recorded in one command buffer (i.e. executed every frame it is submitted)
+struct RenderStateStats {
+    int pipelineBinds = 0;
+    int descriptorSetBinds = 0;
+    int vertexBufferBinds = 0;
+    int drawCalls = 0;
+
+    RenderStateStats& operator+=(const RenderStateStats& other) {
+        pipelineBinds += other.pipelineBinds;
+        descriptorSetBinds += other.descriptorSetBinds;
+        vertexBufferBinds += other.vertexBufferBinds;
+        drawCalls += other.drawCalls;
+        return *this;
+    }
+};
+
+// Objects of the per-frame draw list (see DrawManager)
+struct DrawListStats {
+    int drawnObjects = 0;
+    int uploadedObjects = 0;        // drawn objects whose instance data was written this frame
+    int culledObjects = 0;
+    int disabledObjects = 0;
+};
+
+struct RenderStatsFrame {
+    double frameMs = 0.0;           // since the previous frame (0 for the first one)
+    double gpuMs = 0.0;             // scene and UI passes of an earlier frame (see GpuTimer), 0 if unknown
+    RenderStateStats commands;      // of the scene and UI command buffers submitted
+    DrawListStats drawList;
+    uint64_t triangles = 0;
+    uint64_t uniformBytes = 0;
+    uint32_t buffersCreated = 0;
+    uint32_t buffersDestroyed = 0;
+};
+
+class RenderStats {
+
+    RenderStateStats recording;
+    std::vector<RenderStateStats> sceneCommands;    // per swap chain image
+    std::vector<RenderStateStats> uiCommands;
+
+    std::atomic<uint64_t> triangles{0};
+    std::atomic<uint64_t> uniformBytes{0};
+    std::atomic<uint32_t> buffersCreated{0};
+    std::atomic<uint32_t> buffersDestroyed{0};
+    double gpuMs = 0.0;
+    DrawListStats drawList;
+
+    std::vector<RenderStatsFrame> history = std::vector<RenderStatsFrame>(RENDER_STATS_HISTORY);
+    uint64_t frames = 0;            // frames ended so far, the last RENDER_STATS_HISTORY are in history
+    std::chrono::steady_clock::time_point lastFrameEnd;
+
+    static void store(std::vector<RenderStateStats>& perImage, size_t image, const RenderStateStats& stats) {
+        if (perImage.size() <= image) perImage.resize(image + 1);
+        perImage[image] = stats;
+    }
+
+public:
+
+    void beginRecording() {
+        recording = {};
+    }
+
+    // from one thread at a time (the parallel recorder adds the chunks up on the main thread)
+    void addRecorded(const RenderStateStats& stats) {
+        recording += stats;
+    }
+
+    void endSceneRecording(size_t image) {
+        store(sceneCommands, image, recording);
+    }
+
+    void endUIRecording(size_t image) {
+        store(uiCommands, image, recording);
+    }
+
+    void addTriangles(uint64_t count) {
+        triangles.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void addUniformBytes(uint64_t bytes) {
+        uniformBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void bufferCreated() {
+        buffersCreated.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void bufferDestroyed() {
+        buffersDestroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // the last GPU time read back, reported by the frames until the next one
+    void setGpuTime(double ms) {
+        gpuMs = ms;
+    }
+
+    // from the main thread, before the frame ends
+    void setDrawList(const DrawListStats& stats) {
+        drawList = stats;
+    }
+
+    // closes the counters of the frame that submitted the given image
+    const RenderStatsFrame& endFrame(size_t image) {
+        auto now = std::chrono::steady_clock::now();
+        RenderStatsFrame& frame = history[frames % RENDER_STATS_HISTORY];
+        frame = {};
+        frame.frameMs = frames > 0 ? std::chrono::duration<double, std::milli>(now - lastFrameEnd).count() : 0.0;
+        frame.gpuMs = gpuMs;
+        frame.drawList = drawList;
+        if (image < sceneCommands.size()) frame.commands += sceneCommands[image];
+        if (image < uiCommands.size()) frame.commands += uiCommands[image];
+        frame.triangles = triangles.exchange(0, std::memory_order_relaxed);
+        frame.uniformBytes = uniformBytes.exchange(0, std::memory_order_relaxed);
+        frame.buffersCreated = buffersCreated.exchange(0, std::memory_order_relaxed);
+        frame.buffersDestroyed = buffersDestroyed.exchange(0, std::memory_order_relaxed);
+        lastFrameEnd = now;
+        frames++;
+        return frame;
+    }
+
+    uint64_t getFrameCount() const {
+        return frames;
+    }
+
+    // frames in the history
+    size_t historySize() const {
+        return (size_t)std::min<uint64_t>(frames, RENDER_STATS_HISTORY);
+    }
+
+    // ago = 0 is the last frame ended, up to historySize() - 1
+    const RenderStatsFrame& getFrame(size_t ago) const {
+        return history[(frames - 1 - ago) % RENDER_STATS_HISTORY];
+    }
+
+    // the history, oldest frame first
+    std::vector<RenderStatsFrame> getHistory() const {
+        std::vector<RenderStatsFrame> result;
+        result.reserve(historySize());
+        for (size_t ago = historySize(); ago-- > 0;) {
+            result.push_back(getFrame(ago));
+        }
+        return result;
+    }
+
+    // nearest-rank percentile (0..1) of the frame times in the history, 0 without any
+    double frameTimePercentile(double p) const {
+        std::vector<double> times;
+        times.reserve(historySize());
+        for (size_t ago = 0; ago < historySize(); ago++) {
+            if (getFrame(ago).frameMs > 0.0) times.push_back(getFrame(ago).frameMs);
+        }
+        if (times.empty()) return 0.0;
+        std::sort(times.begin(), times.end());
+        size_t rank = (size_t)std::ceil(p * times.size());
+        return times[std::min(times.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    // frames per second over the last window frames of the history
+    double fps(size_t window = RENDER_STATS_HISTORY) const {
+        double totalMs = 0.0;
+        size_t timed = 0;
+        for (size_t ago = 0; ago < std::min(window, historySize()); ago++) {
+            if (getFrame(ago).frameMs > 0.0) {
+                totalMs += getFrame(ago).frameMs;
+                timed++;
+            }
+        }
+        return totalMs > 0.0 ? timed * 1000.0 / totalMs : 0.0;
+    }
+};
+
+#endif
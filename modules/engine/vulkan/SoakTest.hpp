@@ -0,0 +1,241 @@
+#ifndef SOAK_TEST_HPP
+#define SOAK_TEST_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+/*
+ Soak test mode (started with --soak [seconds]): the game runs unattended for a long time and every
+ SOAK_TEST_LOG_INTERVAL seconds a line with the resident memory of the process, the live device memory
+ allocations and the number of frames and UI command buffer recordings is printed.
+ The first sample after SOAK_TEST_WARMUP seconds is the baseline: loading and the first frames are
+ allowed to grow, after that both the resident set and the device memory in use are expected to stay
+ flat, and the growth against the baseline is printed with every sample and in the final summary.
+ With a duration the window is closed once it has elapsed, without it the test runs until the window is closed.
+
+ The test fails (and the process exits with a non-zero status) when, between the baseline and the last
+ sample, the device memory allocations or the device bytes in use grew, the UI command buffers were
+ recorded again, or the resident set grew by more than SOAK_TEST_MAX_RESIDENT_GROWTH_MB; a test that
+ ends before the warm-up has no baseline and fails too.
+ A swap chain recreation (resize, minimize, display sleep) legitimately reallocates and re-records: the
+ growth up to it is checked right away, and the first sample after it becomes the new baseline.
+ */
+
+const double SOAK_TEST_LOG_INTERVAL = 60.0;
+const double SOAK_TEST_WARMUP = 30.0;
+// the resident set moves a little with the allocator caches and the driver: only a larger growth fails
+const double SOAK_TEST_MAX_RESIDENT_GROWTH_MB = 64.0;
+
+// resident set size of this process in bytes, 0 if the platform does not expose it
+inline uint64_t currentResidentMemory() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (uint64_t)counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        return (uint64_t)info.resident_size;
+    }
+    return 0;
+#else
+    long pages = 0, residentPages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr) return 0;
+    if (fscanf(statm, "%ld %ld", &pages, &residentPages) != 2) residentPages = 0;
+    fclose(statm);
+    return (uint64_t)residentPages * (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+struct SoakTestSample {
+    double elapsed = 0.0;               // seconds since the start of the test
+    uint64_t frames = 0;
+    uint64_t uiRecordings = 0;
+    uint64_t residentBytes = 0;
+    uint64_t deviceBytesInUse = 0;
+    size_t deviceAllocations = 0;
+};
+
+class SoakTest {
+
+    bool enabled = false;
+    double duration = 0.0;              // seconds, 0 runs until the window is closed
+
+    std::chrono::steady_clock::time_point start;
+    double nextLog = 0.0;
+    uint64_t frames = 0;
+
+    bool hasBaseline = false;
+    SoakTestSample baseline;
+    SoakTestSample last;
+    uint64_t peakResidentBytes = 0;
+    bool failed = false;
+
+    uint32_t swapChainRecreations = 0;
+    bool rebaselinePending = false;
+    std::vector<std::string> earlierFailures;   // found before a swap chain recreation
+
+    static double toMB(int64_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    void sample(double elapsed, uint64_t uiRecordings, const MemoryAllocator& allocator) {
+        MemoryAllocatorStats deviceStats = allocator.getStats();
+        last.elapsed = elapsed;
+        last.frames = frames;
+        last.uiRecordings = uiRecordings;
+        last.residentBytes = currentResidentMemory();
+        last.deviceBytesInUse = deviceStats.bytesInUse;
+        last.deviceAllocations = deviceStats.allocationCount;
+        peakResidentBytes = std::max(peakResidentBytes, last.residentBytes);
+
+        print(last);
+        if (!hasBaseline || rebaselinePending) {
+            baseline = last;
+            hasBaseline = true;
+            rebaselinePending = false;
+        }
+    }
+
+    // what grew between the baseline and the last sample, empty if nothing did
+    std::vector<std::string> failures() const {
+        std::vector<std::string> reasons;
+        if (last.deviceAllocations > baseline.deviceAllocations) {
+            reasons.push_back("device memory allocations grew from " + std::to_string(baseline.deviceAllocations)
+                              + " to " + std::to_string(last.deviceAllocations));
+        }
+        if (last.deviceBytesInUse > baseline.deviceBytesInUse) {
+            reasons.push_back("device memory in use grew by " + std::to_string(last.deviceBytesInUse - baseline.deviceBytesInUse) + " bytes");
+        }
+        if (last.uiRecordings > baseline.uiRecordings) {
+            reasons.push_back("UI command buffers recorded " + std::to_string(last.uiRecordings - baseline.uiRecordings) + " more times");
+        }
+        double residentGrowth = toMB((int64_t)last.residentBytes - (int64_t)baseline.residentBytes);
+        if (residentGrowth > SOAK_TEST_MAX_RESIDENT_GROWTH_MB) {
+            reasons.push_back("RSS grew by " + std::to_string(residentGrowth) + " MB (limit "
+                              + std::to_string(SOAK_TEST_MAX_RESIDENT_GROWTH_MB) + " MB)");
+        }
+        return reasons;
+    }
+
+    void print(const SoakTestSample& sample) const {
+        std::cout << "Soak test [" << (int)sample.elapsed << " s]: " << sample.frames << " frames, "
+                  << sample.uiRecordings << " UI recordings, RSS " << toMB((int64_t)sample.residentBytes) << " MB, device memory "
+                  << toMB((int64_t)sample.deviceBytesInUse) << " MB in " << sample.deviceAllocations << " allocations";
+        if (hasBaseline) {
+            std::cout << " (RSS " << toMB((int64_t)sample.residentBytes - (int64_t)baseline.residentBytes)
+                      << " MB, device " << toMB((int64_t)sample.deviceBytesInUse - (int64_t)baseline.deviceBytesInUse)
+                      << " MB since the baseline)";
+        }
+        std::cout << "\n";
+    }
+
+public:
+
+    void enable(double seconds) {
+        enabled = true;
+        duration = seconds;
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    void begin() {
+        if (!enabled) return;
+        start = std::chrono::steady_clock::now();
+        nextLog = SOAK_TEST_WARMUP;
+        std::cout << "Soak test started";
+        if (duration > 0.0) std::cout << " for " << duration << " s";
+        std::cout << ", logging every " << SOAK_TEST_LOG_INTERVAL << " s\n";
+    }
+
+    // called once per frame; returns false when the requested duration has elapsed
+    bool frame(uint64_t uiRecordings, const MemoryAllocator& allocator) {
+        if (!enabled) return true;
+        frames++;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bool finished = duration > 0.0 && elapsed >= duration;
+        if (elapsed < nextLog && !finished) return true;
+
+        sample(elapsed, uiRecordings, allocator);
+        nextLog = elapsed + SOAK_TEST_LOG_INTERVAL;
+        return !finished;
+    }
+
+    // called before the swap chain is recreated: checks the growth since the baseline, which is taken again
+    // at the next sample (the recreation reallocates the attachments and re-records the UI command buffers)
+    void swapChainRecreated(uint64_t uiRecordings, const MemoryAllocator& allocator) {
+        if (!enabled) return;
+        swapChainRecreations++;
+        if (!hasBaseline || rebaselinePending) return;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sample(elapsed, uiRecordings, allocator);
+        for (const std::string& reason : failures()) {
+            earlierFailures.push_back(reason + " (before swap chain recreation " + std::to_string(swapChainRecreations) + ")");
+        }
+        rebaselinePending = true;
+    }
+
+    // takes a last sample (the window may have been closed between two logs), prints the summary and the
+    // verdict; false if the test failed
+    bool end(uint64_t uiRecordings, const MemoryAllocator& allocator) {
+        if (!enabled) return true;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= SOAK_TEST_WARMUP && frames > last.frames) {
+            sample(elapsed, uiRecordings, allocator);
+        }
+        std::cout << "Soak test finished after " << (int)last.elapsed << " s and " << frames << " frames\n";
+        if (!hasBaseline) {
+            std::cout << "Soak test FAILED: ended before the warm-up, no baseline to compare with\n";
+            failed = true;
+            return false;
+        }
+        std::cout << "Soak test: RSS " << toMB((int64_t)baseline.residentBytes) << " MB at the baseline, "
+                  << toMB((int64_t)last.residentBytes) << " MB at the end, " << toMB((int64_t)peakResidentBytes)
+                  << " MB peak; device memory " << baseline.deviceAllocations << " -> " << last.deviceAllocations
+                  << " allocations, " << toMB((int64_t)last.deviceBytesInUse - (int64_t)baseline.deviceBytesInUse)
+                  << " MB growth";
+        if (swapChainRecreations > 0) {
+            std::cout << " (since the last of " << swapChainRecreations << " swap chain recreations)";
+        }
+        std::cout << "\n";
+
+        std::vector<std::string> reasons = earlierFailures;
+        if (!rebaselinePending) {
+            for (const std::string& reason : failures()) reasons.push_back(reason);
+        }
+        failed = !reasons.empty();
+        if (failed) {
+            std::cout << "Soak test FAILED:\n";
+            for (const std::string& reason : reasons) {
+                std::cout << "  " << reason << "\n";
+            }
+        } else {
+            std::cout << "Soak test passed: no growth after the warm-up\n";
+        }
+        return !failed;
+    }
+
+    bool hasFailed() const { return failed; }
+};
+
+#endif
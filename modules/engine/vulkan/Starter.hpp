@@ -47,6 +47,17 @@
 
 // WARNING: addedy by us
 #include "../modules/data/Signals.hpp"
+#include "MeshCache.hpp"
+#include "MeshOptimizer.hpp"
+#include "TextureCache.hpp"
+#include "MemoryAllocator.hpp"
+#include "SoakTest.hpp"
+#include "../main/Profiler.hpp"
+#include "ParallelRecorder.hpp"
+#include "PipelineCache.hpp"
+#include "InputReplay.hpp"
+#include "GpuTimer.hpp"
+#include "RenderStats.hpp"
 
 // For compile compatibility issues
 #ifndef M_E
@@ -251,19 +262,30 @@ struct VertexDescriptor {
 
 enum ModelType {OBJ, GLTF, MGCG};
 
+// WARNING: added by us - read-only view of the positions and indices a Model keeps on the CPU
+// (e.g. for the physics meshes), valid as long as the Model is alive
+struct ModelMeshView {
+	const unsigned char *positions;
+	uint32_t positionStride;
+	uint32_t vertexCount;
+	const uint32_t *indices;
+	uint32_t indexCount;
+};
+
 class Model {
 	BaseProject *BP;
 	
 	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
+	MemoryAllocation vertexBufferMemory;
 	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	MemoryAllocation indexBufferMemory;
 	VertexDescriptor *VD;
     
     struct PendingResource {
             VkBuffer buffer;
-            VkDeviceMemory memory;
+            MemoryAllocation memory;
             VkFence fence;
+            VkCommandBuffer commandBuffer;  // empty submission that signals the fence
         };
     std::vector<PendingResource> pendingResources;
     
@@ -273,6 +295,7 @@ class Model {
 
 	public:
     
+	// kept after the upload: the physics meshes are built on top of them (see getMeshView)
 	std::vector<unsigned char> vertices{};
 	std::vector<uint32_t> indices{};
     
@@ -281,8 +304,17 @@ class Model {
     std::string fileName;
     ModelType type;
     
-	void loadModelOBJ(std::string file);
-	void loadModelGLTF(std::string file, bool encoded);
+    // WARNING: added by us - model space bounding volumes, computed at load time (see computeBounds)
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    glm::vec3 boundsExtent = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    
+	void loadModelOBJ(std::string file, std::ostream &log);
+	void loadModelGLTF(std::string file, bool encoded, std::ostream &log);
+	void optimizeMesh(std::ostream &log);
+	uint64_t vertexLayoutHash();
 	void createIndexBuffer();
 	void createVertexBuffer();
     void updateIndexBuffer();
@@ -290,26 +322,43 @@ class Model {
     void destroyPendingResources();
 
 	void init(BaseProject *bp, VertexDescriptor *VD, std::string modelName, std::string file, ModelType MT);
+	void load(BaseProject *bp, VertexDescriptor *VD, std::string modelName, std::string file, ModelType MT, std::ostream &log = std::cout);
+	void upload();
+	void releaseDecoded();
 	void initMesh(BaseProject *bp, VertexDescriptor *VD);
     void updateMesh(BaseProject *bp, VertexDescriptor *VD);
 	void cleanup();
     void replaceVertexBuffer(VkDeviceSize newsize);
     void replaceIndexBuffer(VkDeviceSize newsize);
   	void bind(VkCommandBuffer commandBuffer);
+	ModelMeshView getMeshView();
+	void computeBounds();
 };
 
 struct Texture {
 	BaseProject *BP;
 	uint32_t mipLevels;
 	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
+	MemoryAllocation textureImageMemory;
 	VkImageView textureImageView;
 	VkSampler textureSampler;
 	int imgs;
 	static const int maxImgs = 6;
     
     bool clean = false;
+    
+    // WARNING: added by us - decoded images waiting for upload (see load / upload)
+    int texWidth = 0, texHeight = 0;
+    stbi_uc* pixels[maxImgs] = {};
+    // single images go through the texture cache: mip chain built on the CPU, stored channel count kept
+    BakedTexture baked;
+    VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    VkComponentMapping swizzle{};
 	
+	void loadPixels(std::string files[], std::ostream &log = std::cout);
+	void loadBaked(std::string file, std::ostream &log);
+	void createBakedTextureImage();
+	void createTextureImage(VkFormat Fmt);
 	void createTextureImage(std::string files[], VkFormat Fmt);
 	void createTextureImageView(VkFormat Fmt);
 	void createTextureSampler(VkFilter magFilter,
@@ -323,6 +372,9 @@ struct Texture {
 							);
 
 	void init(BaseProject *bp, std::string file, VkFormat Fmt, bool initSampler);
+	void load(BaseProject *bp, std::string file, VkFormat Fmt, std::ostream &log);
+	void upload(bool initSampler);
+	void releaseDecoded();
 	void initCubic(BaseProject *bp, std::string files[6]);
 	void cleanup();
 };
@@ -371,7 +423,8 @@ struct Pipeline {
 	void cleanup();
 };
 
-enum DescriptorSetElementType {UNIFORM, TEXTURE};
+// WARNING: STORAGE added by us (per-instance data of instanced draws)
+enum DescriptorSetElementType {UNIFORM, TEXTURE, STORAGE};
 
 struct DescriptorSetElement {
 	int binding;
@@ -384,7 +437,7 @@ struct DescriptorSet {
 	BaseProject *BP;
 
 	std::vector<std::vector<VkBuffer>> uniformBuffers;
-	std::vector<std::vector<VkDeviceMemory>> uniformBuffersMemory;
+	std::vector<std::vector<MemoryAllocation>> uniformBuffersMemory;
 	std::vector<VkDescriptorSet> descriptorSets;
 	
 	std::vector<bool> toFree;
@@ -396,6 +449,82 @@ struct DescriptorSet {
   	void map(int currentImage, void *src, int size, int slot);
 };
 
+// WARNING: added by us
+// Records all the transfers and barriers of a load phase into a single command buffer, submitted with
+// a single fence when the outermost end() is reached (or earlier, if the staging ring runs out of space).
+// Staging memory comes from a persistently mapped ring that is reused by every load phase.
+// begin() / end() pairs nest, so a single upload can be batched by whoever is loading many of them.
+class UploadBatch {
+	BaseProject *BP = nullptr;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	bool recording = false;
+	int depth = 0;
+
+	VkBuffer ringBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory ringMemory = VK_NULL_HANDLE;
+	unsigned char *ringData = nullptr;
+	VkDeviceSize ringSize = 0;
+	VkDeviceSize ringHead = 0;
+
+	// uploads bigger than the whole ring get a dedicated buffer, freed after the next submission
+	struct DedicatedStaging {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+	};
+	std::vector<DedicatedStaging> dedicated;
+
+	int submitCount = 0;
+	VkDeviceSize stagedBytes = 0;
+
+	void beginCommands();
+	void submitAndWait();
+
+	public:
+	struct StagingSlice {
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void *mapped;
+	};
+
+	void init(BaseProject *bp, VkDeviceSize stagingRingSize);
+	void begin();
+	void end();
+	// may submit the commands recorded so far: always fetch commands() after staging
+	StagingSlice stage(VkDeviceSize size, VkDeviceSize alignment = 16);
+	StagingSlice stage(const void *data, VkDeviceSize size, VkDeviceSize alignment = 16);
+	VkCommandBuffer commands();
+	void cleanup();
+};
+
+// begin() / end() of an UploadBatch as a scope: end() submits and reports its errors, the destructor only
+// closes a scope left by an exception, so the nesting of the batch stays balanced
+class UploadBatchScope {
+	UploadBatch &batch;
+	bool open = true;
+
+	public:
+	explicit UploadBatchScope(UploadBatch &b) : batch(b) {
+		batch.begin();
+	}
+	UploadBatchScope(const UploadBatchScope&) = delete;
+	UploadBatchScope& operator=(const UploadBatchScope&) = delete;
+
+	void end() {
+		open = false;
+		batch.end();
+	}
+
+	~UploadBatchScope() {
+		if(open) {
+			try {
+				batch.end();
+			} catch (...) {
+				// already unwinding from the error that skipped end()
+			}
+		}
+	}
+};
 
 // MAIN ! 
 class BaseProject {
@@ -405,15 +534,112 @@ class BaseProject {
 	friend class Pipeline;
 	friend class DescriptorSetLayout;
 	friend class DescriptorSet;
+	friend class UploadBatch;
+	friend class InstanceGroup;
+	friend class TextMaker;
 public:
 	virtual void setWindowParameters() = 0;
+	
+	// WARNING: added by us
+	UploadBatch &getUploadBatch() {
+		return uploadBatch;
+	}
+	MemoryAllocator &getMemoryAllocator() {
+		return memoryAllocator;
+	}
+	RenderStats &getRenderStats() {
+		return renderStats;
+	}
+	// every buffer made by createBuffer goes away through here, so that the render stats can count them
+	void destroyBuffer(VkBuffer buffer) {
+		vkDestroyBuffer(device, buffer, nullptr);
+		renderStats.bufferDestroyed();
+	}
+	uint64_t getUIRecordings() const {
+		return uiRecordings;
+	}
+	void enableSoakTest(double seconds) {
+		soakTest.enable(seconds);
+	}
+	// after run(): the soak test found a leak (see SoakTest)
+	bool soakTestFailed() const {
+		return soakTest.hasFailed();
+	}
+	// every pipeline is compiled from scratch, to measure what the pipeline cache saves
+	void disablePipelineCache() {
+		pipelineCacheEnabled = false;
+	}
+	// threads = 0 uses every core; 1 keeps the scene recording on the main thread
+	void enableParallelRecording(unsigned threads) {
+		recordingThreads = threads;
+	}
+	// records the scene command buffer of every frame again, instead of once per swap chain image: what a
+	// scene whose draw list changes every frame would cost (see ParallelRecorder)
+	void enableSceneRecordingEveryFrame() {
+		recordSceneEveryFrame = true;
+	}
+	// records a synthetic draw list of the given size with 1, 2, 4... threads instead of running the game
+	void enableRecordingBenchmark(size_t objects) {
+		recordingBenchmarkObjects = objects;
+	}
+	// renders the given number of frames into offscreen images, without a window, surface or swap chain
+	void enableHeadless(uint32_t frames, uint32_t width, uint32_t height) {
+		headless = true;
+		headlessFrames = frames;
+		headlessExtent = {width, height};
+	}
+	// saves the given headless frame (0 is the first) as headless_frame_<n>.png
+	void dumpHeadlessFrame(uint32_t frame) {
+		headlessDumpFrames.insert(frame);
+	}
+	bool isHeadless() const {
+		return headless;
+	}
+	// saves the input of every frame to a file, for enableInputReplay
+	void enableInputRecording(const std::string& path) {
+		inputReplay.record(path);
+	}
+	// plays a recorded input back with a fixed timestep (<= 0 uses the recorded ones) and writes a
+	// report of the CPU time of each frame when the recording runs out
+	void enableInputReplay(const std::string& path, double timestep, const std::string& reportPath) {
+		inputReplay.play(path, timestep, reportPath);
+	}
+	// records the PROFILE_SCOPE markers from the start; the trace is written by dumpProfile and at exit
+	void enableProfiler(const std::string& tracePath) {
+		profileTracePath = tracePath;
+		Profiler::enable();
+	}
+	// writes the markers recorded so far (the last PROFILER_EVENTS_PER_THREAD of each thread)
+	void dumpProfile() {
+		if (Profiler::isEnabled()) {
+			Profiler::dumpChromeTrace(profileTracePath);
+		}
+	}
+	// the keys the game logic reads: recorded while recording, taken from the recording while replaying
+	bool isKeyPressed(int key) {
+		return inputReplay.keyPressed(window, key);
+	}
     void run() {
     	windowResizable = GLFW_FALSE;
 
     	setWindowParameters();
+    	if (headless) {
+    		// the frames are never resized: the application adapts once, as to a window of that size
+    		windowWidth = headlessExtent.width;
+    		windowHeight = headlessExtent.height;
+    		onWindowResize(windowWidth, windowHeight);
+    	}
+        PROFILE_THREAD_NAME("main");
+        inputReplay.begin();
         initWindow();
         initVulkan();
-        mainLoop();
+        if (recordingBenchmarkObjects > 0) {
+        	recordingBenchmark();
+        } else {
+        	mainLoop();
+        	inputReplay.end();
+        }
+        dumpProfile();
         cleanup();
     }
 
@@ -423,9 +649,11 @@ protected:
 	bool windowResizable;
 	std::string windowTitle;
 	VkClearColorValue initialBackgroundColor;
-	int uniformBlocksInPool;
-	int texturesInPool;
-	int setsInPool;
+	int uniformBlocksInPool = 0;
+	int texturesInPool = 0;
+	int setsInPool = 0;
+	// WARNING: added by us
+	int storageBlocksInPool = 0;
 
     GLFWwindow* window;
     VkInstance instance;
@@ -437,7 +665,15 @@ protected:
     VkQueue presentQueue;
 	VkCommandPool commandPool;
 	std::vector<VkCommandBuffer> commandBuffers;
-    VkCommandBuffer uiCommandBuffer;
+	// WARNING: changed by us - one UI command buffer per swap chain image, recorded the first time its
+	// image comes up after the swap chain was (re)created. Text changes, camera switches, enabled / disabled
+	// objects and lights are per-frame uniform or indirect draw data: none of them needs the command
+	// buffers recorded again
+    std::vector<VkCommandBuffer> uiCommandBuffers;
+    std::vector<bool> uiRecorded;
+    uint64_t uiRecordings = 0;
+    // WARNING: added by us - same for the scene command buffers (recorded up front by createCommandBuffers)
+    std::vector<bool> sceneRecorded;
 
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
@@ -469,7 +705,35 @@ protected:
 	std::vector<VkFence> inFlightFences;
 	std::vector<VkFence> imagesInFlight;
 	
+	// WARNING: added by us
+	UploadBatch uploadBatch;
+	MemoryAllocator memoryAllocator;
+	SoakTest soakTest;
+	unsigned recordingThreads = 1;
+	ParallelRecorder parallelRecorder;
+	bool recordSceneEveryFrame = false;
+	bool pipelineCacheEnabled = true;
+	PipelineCache pipelineCache;
+	size_t recordingBenchmarkObjects = 0;
+	// headless mode: the swap chain images are plain offscreen images, left in TRANSFER_SRC layout
+	bool headless = false;
+	uint32_t headlessFrames = 0;
+	uint32_t headlessFrame = 0;
+	VkExtent2D headlessExtent{};
+	std::set<uint32_t> headlessDumpFrames;
+	std::vector<VkDeviceMemory> offscreenImagesMemory;
+	bool validationEnabled = true;
+	InputReplay inputReplay;
+	GpuTimer gpuTimer;
+	RenderStats renderStats;
+	std::string profileTracePath = "profile_trace.json";
+	
     void initWindow() {
+        // WARNING: added by us - no GLFW at all in headless mode, window stays null
+        if (headless) {
+            window = nullptr;
+            return;
+        }
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -506,14 +770,25 @@ protected:
 		createImageViews();				
 		createRenderPass();			
 		createCommandPool();			
+		memoryAllocator.init(device, physicalDevice);
+		pipelineCache.init(device, physicalDevice, pipelineCacheEnabled);
+		uploadBatch.init(this, 64 * 1024 * 1024);
 		createColorResources();
 		createDepthResources();			
 		createFramebuffers();			
-		createDescriptorPool();			
 
 		localInit();
+		// WARNING: changed by us - after localInit, which loads the scene and sizes the pool from it
+		createDescriptorPool();
 		pipelinesAndDescriptorSetsInit();
+		pipelineCache.printCreationStats("startup");
 
+		if (recordingThreads != 1) {
+			parallelRecorder.init(device, findQueueFamilies(physicalDevice).graphicsFamily.value(), recordingThreads);
+			std::cout << "Recording the scene on " << parallelRecorder.getThreadCount() << " threads\n";
+		}
+		gpuTimer.init(device, physicalDevice, findQueueFamilies(physicalDevice).graphicsFamily.value(),
+					  gpuTimerGroups(), parallelRecorder.isEnabled() ? parallelRecorder.getThreadCount() : 1);
 		createCommandBuffers();
 		createSyncObjects();
     }
@@ -532,27 +807,29 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		createInfo.pApplicationInfo = &appInfo;
 
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-				
 //		createInfo.enabledExtensionCount = glfwExtensionCount;
 //		createInfo.ppEnabledExtensionNames = glfwExtensions;
 
 		createInfo.enabledLayerCount = 0;
 
+		// WARNING: changed by us - CI machines running headless often have no validation layers installed
+		if (!checkValidationLayerSupport()) {
+			if (!headless) {
+				throw std::runtime_error("validation layers requested, but not available!");
+			}
+			std::cout << "Validation layers not available, running headless without them\n";
+			validationEnabled = false;
+		}
+
 		auto extensions = getRequiredExtensions();
 		createInfo.enabledExtensionCount =
 			static_cast<uint32_t>(extensions.size());
 		createInfo.ppEnabledExtensionNames = extensions.data();		
 
 		createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
-		
-		if (!checkValidationLayerSupport()) {
-			throw std::runtime_error("validation layers requested, but not available!");
-		}
 
 		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
+		if (validationEnabled) {
 			createInfo.enabledLayerCount =
 				static_cast<uint32_t>(validationLayers.size());
 			createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -560,6 +837,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			populateDebugMessengerCreateInfo(debugCreateInfo);
 			createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)
 									&debugCreateInfo;
+		}
 		
 		VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
 		
@@ -570,15 +848,19 @@ std::cout << "Starting createInstance()\n"  << std::flush;
     }
     
     std::vector<const char*> getRequiredExtensions() {
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions =
-			glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-		std::vector<const char*> extensions(glfwExtensions,
-			glfwExtensions + glfwExtensionCount);
+		std::vector<const char*> extensions;
+		// WARNING: changed by us - no surface extensions in headless mode
+		if (!headless) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions =
+				glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 			
-		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);		
+		if (validationEnabled) {
+			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		}
 		
 		if(checkIfItHasExtension(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME)) {
 			extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
@@ -680,6 +962,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	}
 
 	void setupDebugMessenger() {
+		if (!validationEnabled) return;
 
 		VkDebugUtilsMessengerCreateInfoEXT createInfo{};
 		populateDebugMessengerCreateInfo(createInfo);
@@ -691,6 +974,10 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	}
 
     void createSurface() {
+    	if (headless) {
+    		surface = VK_NULL_HANDLE;
+    		return;
+    	}
     	if (glfwCreateWindowSurface(instance, window, nullptr, &surface)
     			!= VK_SUCCESS) {
 			throw std::runtime_error("failed to create window surface!");
@@ -722,6 +1009,12 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	};
 
     void pickPhysicalDevice() {
+    	// WARNING: added by us - offscreen rendering needs no swap chain
+    	if (headless) {
+    		deviceExtensions.erase(std::remove_if(deviceExtensions.begin(), deviceExtensions.end(),
+    				[](const char* ext) { return strcmp(ext, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; }),
+    				deviceExtensions.end());
+    	}
     	uint32_t deviceCount = 0;
     	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 		deviceReport devRep;
@@ -762,8 +1055,8 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 
 		devRep.extensionsSupported = checkDeviceExtensionSupport(device, devRep);
 
-		devRep.swapChainAdequate = false;
-		if (devRep.extensionsSupported) {
+		devRep.swapChainAdequate = headless;
+		if (devRep.extensionsSupported && !headless) {
 			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 			devRep.swapChainFormatSupport = swapChainSupport.formats.empty();
 			devRep.swapChainPresentModeSupport = swapChainSupport.presentModes.empty();
@@ -798,9 +1091,14 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 				indices.graphicsFamily = i;
 			}
 				
+			// WARNING: changed by us - headless, nothing is presented: the graphics queue stands in
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface,
-												 &presentSupport);
+			if (headless) {
+				presentSupport = indices.graphicsFamily.has_value();
+			} else {
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface,
+													 &presentSupport);
+			}
 			if (presentSupport) {
 			 	indices.presentFamily = i;
 			}
@@ -914,9 +1212,11 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 				static_cast<uint32_t>(deviceExtensions.size());
 		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
+		if (validationEnabled) {
 			createInfo.enabledLayerCount = 
 					static_cast<uint32_t>(validationLayers.size());
 			createInfo.ppEnabledLayerNames = validationLayers.data();
+		}
 		
 		VkResult result = vkCreateDevice(physicalDevice, &createInfo, nullptr, &device);
 		
@@ -930,6 +1230,10 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	}
 	
 	void createSwapChain() {
+		if (headless) {
+			createOffscreenImages();
+			return;
+		}
 		SwapChainSupportDetails swapChainSupport =
 				querySwapChainSupport(physicalDevice);
 		VkSurfaceFormatKHR surfaceFormat =
@@ -989,6 +1293,28 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		swapChainImageFormat = surfaceFormat.format;
 		swapChainExtent = extent;
 	}
+	
+	// WARNING: added by us - headless stand-in for the swap chain: as many images as a swap chain would
+	// have, in the format chooseSwapSurfaceFormat prefers, so the render pass and the pipelines are the same
+	void createOffscreenImages() {
+		swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+		swapChainExtent = headlessExtent;
+		
+		swapChainImages.resize(MAX_FRAMES_IN_FLIGHT + 1);
+		offscreenImagesMemory.resize(swapChainImages.size());
+		for (size_t i = 0; i < swapChainImages.size(); i++) {
+			createImage(swapChainExtent.width, swapChainExtent.height, 1, 1,
+						VK_SAMPLE_COUNT_1_BIT, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+						VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 0,
+						VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+						swapChainImages[i], offscreenImagesMemory[i]);
+		}
+	}
+	
+	// layout of a finished frame: ready to present, or to be read back when there is nothing to present to
+	VkImageLayout presentedImageLayout() const {
+		return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
 
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(
 				const std::vector<VkSurfaceFormatKHR>& availableFormats)
@@ -1045,13 +1371,15 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	
 	VkImageView createImageView(VkImage image, VkFormat format,
 								VkImageAspectFlags aspectFlags,
-								uint32_t mipLevels, VkImageViewType type, int layerCount
+								uint32_t mipLevels, VkImageViewType type, int layerCount,
+								VkComponentMapping components = {}
 								) {
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image = image;
 		viewInfo.viewType = type;
 		viewInfo.format = format;
+		viewInfo.components = components;
 		viewInfo.subresourceRange.aspectMask = aspectFlags;
 		viewInfo.subresourceRange.baseMipLevel = 0;
 		viewInfo.subresourceRange.levelCount = mipLevels;
@@ -1077,7 +1405,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachmentResolve.finalLayout = presentedImageLayout();
 
 		VkAttachmentReference colorAttachmentResolveRef{};
 		colorAttachmentResolveRef.attachment = 2;
@@ -1256,14 +1584,13 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			   format == VK_FORMAT_D24_UNORM_S8_UINT;
 	}
 		
-	void createImage(uint32_t width, uint32_t height,
+	// WARNING: added by us - the image without its memory, shared by the two createImage below
+	VkMemoryRequirements createUnboundImage(uint32_t width, uint32_t height,
 					 uint32_t mipLevels, int imgCount,
 					 VkSampleCountFlagBits numSamples, 
 					 VkFormat format,
 				 	 VkImageTiling tiling, VkImageUsageFlags usage,
-				 	 VkImageCreateFlags cflags,
-				 	 VkMemoryPropertyFlags properties, VkImage& image,
-				 	 VkDeviceMemory& imageMemory) {		
+				 	 VkImageCreateFlags cflags, VkImage& image) {
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -1288,6 +1615,19 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(device, image, &memRequirements);
+		return memRequirements;
+	}
+	
+	void createImage(uint32_t width, uint32_t height,
+					 uint32_t mipLevels, int imgCount,
+					 VkSampleCountFlagBits numSamples, 
+					 VkFormat format,
+				 	 VkImageTiling tiling, VkImageUsageFlags usage,
+				 	 VkImageCreateFlags cflags,
+				 	 VkMemoryPropertyFlags properties, VkImage& image,
+				 	 VkDeviceMemory& imageMemory) {		
+		VkMemoryRequirements memRequirements = createUnboundImage(width, height, mipLevels, imgCount,
+				numSamples, format, tiling, usage, cflags, image);
 
 		VkMemoryAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -1302,9 +1642,37 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		vkBindImageMemory(device, image, imageMemory, 0);
 	}
 
+	// WARNING: added by us - same as above, with the memory suballocated from the shared blocks
+	void createImage(uint32_t width, uint32_t height,
+					 uint32_t mipLevels, int imgCount,
+					 VkSampleCountFlagBits numSamples, 
+					 VkFormat format,
+				 	 VkImageTiling tiling, VkImageUsageFlags usage,
+				 	 VkImageCreateFlags cflags,
+				 	 VkMemoryPropertyFlags properties, VkImage& image,
+				 	 MemoryAllocation& imageMemory) {		
+		VkMemoryRequirements memRequirements = createUnboundImage(width, height, mipLevels, imgCount,
+				numSamples, format, tiling, usage, cflags, image);
+
+		imageMemory = memoryAllocator.allocate(memRequirements, properties,
+											tiling == VK_IMAGE_TILING_LINEAR);
+
+		vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+	}
+
 	void generateMipmaps(VkImage image, VkFormat imageFormat,
 						 int32_t texWidth, int32_t texHeight,
 						 uint32_t mipLevels, int layerCount) {
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		recordGenerateMipmaps(commandBuffer, image, imageFormat, texWidth, texHeight, mipLevels, layerCount);
+		endSingleTimeCommands(commandBuffer);
+	}
+	
+	// WARNING: added by us - the record* helpers only record into the given command buffer,
+	// so that many of them can share one submission (see UploadBatch)
+	void recordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat,
+						 int32_t texWidth, int32_t texHeight,
+						 uint32_t mipLevels, int layerCount) {
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat,
 							&formatProperties);
@@ -1314,8 +1682,6 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			throw std::runtime_error("texture image format does not support linear blitting!");
 		}
 
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-		
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.image = image;
@@ -1386,15 +1752,19 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 							 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
 							 0, nullptr, 0, nullptr,
 							 1, &barrier);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 	
 	void transitionImageLayout(VkImage image, VkFormat format,
 					VkImageLayout oldLayout, VkImageLayout newLayout,
 					uint32_t mipLevels, int layersCount) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+		recordImageLayoutTransition(commandBuffer, image, format, oldLayout, newLayout, mipLevels, layersCount);
+		endSingleTimeCommands(commandBuffer);
+	}
+	
+	void recordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format,
+					VkImageLayout oldLayout, VkImageLayout newLayout,
+					uint32_t mipLevels, int layersCount) {
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.oldLayout = oldLayout;
@@ -1446,16 +1816,19 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		vkCmdPipelineBarrier(commandBuffer,
 								sourceStage, destinationStage, 0,
 								0, nullptr, 0, nullptr, 1, &barrier);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 	
 	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t
 						   width, uint32_t height, int layerCount) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-		
+		recordCopyBufferToImage(commandBuffer, buffer, 0, image, width, height, layerCount);
+		endSingleTimeCommands(commandBuffer);
+	}
+	
+	void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+						   VkImage image, uint32_t width, uint32_t height, int layerCount) {
 		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
+		region.bufferOffset = bufferOffset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1467,8 +1840,25 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		
 		vkCmdCopyBufferToImage(commandBuffer, buffer, image,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-		endSingleTimeCommands(commandBuffer);
+	}
+	
+	// WARNING: added by us - copies a whole pre-built mip chain in one go
+	void recordCopyBufferToImageMips(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+							   VkImage image, const std::vector<TextureMipLevel> &mips) {
+		std::vector<VkBufferImageCopy> regions(mips.size());
+		for(uint32_t i = 0; i < mips.size(); i++) {
+			regions[i] = {};
+			regions[i].bufferOffset = bufferOffset + mips[i].offset;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = i;
+			regions[i].imageSubresource.baseArrayLayer = 0;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = {0, 0, 0};
+			regions[i].imageExtent = {mips[i].width, mips[i].height, 1};
+		}
+		
+		vkCmdCopyBufferToImage(commandBuffer, buffer, image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
 	}
 	
 	VkCommandBuffer beginSingleTimeCommands() { 
@@ -1503,9 +1893,8 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 	}
 	
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
-					  VkMemoryPropertyFlags properties,
-					  VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+	// WARNING: added by us - the buffer without its memory, shared by the two createBuffer below
+	VkMemoryRequirements createUnboundBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer) {
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
@@ -1518,9 +1907,17 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		 	PrintVkError(result);
 			throw std::runtime_error("failed to create vertex buffer!");
 		}
+		renderStats.bufferCreated();
 		
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+		return memRequirements;
+	}
+	
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+					  VkMemoryPropertyFlags properties,
+					  VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+		VkMemoryRequirements memRequirements = createUnboundBuffer(size, usage, buffer);
 		
 		VkMemoryAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -1528,7 +1925,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		allocInfo.memoryTypeIndex =
 				findMemoryType(memRequirements.memoryTypeBits, properties);
 
-		result = vkAllocateMemory(device, &allocInfo, nullptr,
+		VkResult result = vkAllocateMemory(device, &allocInfo, nullptr,
 				&bufferMemory);
 		if (result != VK_SUCCESS) {
 		 	PrintVkError(result);
@@ -1537,6 +1934,17 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		
         vkBindBufferMemory(device, buffer, bufferMemory, 0);
 	}
+
+	// WARNING: added by us - same as above, with the memory suballocated from the shared blocks
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+					  VkMemoryPropertyFlags properties,
+					  VkBuffer& buffer, MemoryAllocation& bufferMemory) {
+		VkMemoryRequirements memRequirements = createUnboundBuffer(size, usage, buffer);
+		
+		bufferMemory = memoryAllocator.allocate(memRequirements, properties, true);
+		
+        vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+	}
 	
 	uint32_t findMemoryType(uint32_t typeFilter,
 							VkMemoryPropertyFlags properties) {
@@ -1555,13 +1963,20 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	}
     
 	void createDescriptorPool() {
-		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		std::vector<VkDescriptorPoolSize> poolSizes(2);
 		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		poolSizes[0].descriptorCount = static_cast<uint32_t>(uniformBlocksInPool *
 															 swapChainImages.size());
 		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		poolSizes[1].descriptorCount = static_cast<uint32_t>(texturesInPool *
 															 swapChainImages.size());
+		if(storageBlocksInPool > 0) {
+			VkDescriptorPoolSize storageSize{};
+			storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			storageSize.descriptorCount = static_cast<uint32_t>(storageBlocksInPool *
+															 swapChainImages.size());
+			poolSizes.push_back(storageSize);
+		}
 															 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1579,9 +1994,24 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	
 	virtual void populateCommandBuffer(VkCommandBuffer commandBuffer, int i) = 0;
     virtual void populateDynamicCommandBuffer(VkCommandBuffer commandBuffer, int i) = 0;
+    
+    // WARNING: added by us - records the scene of image i into secondaries with the given recorder and returns
+    // them; the default records populateCommandBuffer into a single secondary
+    virtual const std::vector<VkCommandBuffer>& populateCommandBufferParallel(ParallelRecorder& recorder, int i) {
+    	return recorder.record(i, 1, [this, i](VkCommandBuffer commandBuffer, unsigned chunk, size_t first, size_t last) {
+    		populateCommandBuffer(commandBuffer, i);
+    	});
+    }
+    // WARNING: added by us - replaces the draw list with a synthetic one of the given size, for recordingBenchmark
+    virtual void buildRecordingBenchmarkScene(size_t objects) {}
+    // WARNING: added by us - names of the pipeline groups timed by gpuTimer, by the index the scene times them with
+    virtual std::vector<std::string> gpuTimerGroups() {
+    	return {};
+    }
 
     void createCommandBuffers() {
     	commandBuffers.resize(swapChainFramebuffers.size());
+    	gpuTimer.prepare(swapChainFramebuffers.size());
     	
         VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1596,56 +2026,96 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			throw std::runtime_error("failed to allocate command buffers!");
 		}
 		
+		// WARNING: added by us - allocated once here, reset and re-recorded by updateCommandBufferForUI
+		uiCommandBuffers.resize(swapChainFramebuffers.size());
+		result = vkAllocateCommandBuffers(device, &allocInfo, uiCommandBuffers.data());
+		if (result != VK_SUCCESS) {
+		 	PrintVkError(result);
+			throw std::runtime_error("failed to allocate UI command buffers!");
+		}
+		uiRecorded.assign(uiCommandBuffers.size(), false);
+		
+		if (parallelRecorder.isEnabled()) {
+			parallelRecorder.prepare(renderPass, swapChainFramebuffers);
+		}
+		
+		sceneRecorded.assign(commandBuffers.size(), false);
 		for (size_t i = 0; i < commandBuffers.size(); i++) {
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0; // Optional
-			beginInfo.pInheritanceInfo = nullptr; // Optional
-
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) !=
-						VK_SUCCESS) {
-				throw std::runtime_error("failed to begin recording command buffer!");
-			}
-			
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass; 
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = {0, 0};
-			renderPassInfo.renderArea.extent = swapChainExtent;
-	
-			std::array<VkClearValue, 2> clearValues{};
-			clearValues[0].color = initialBackgroundColor;
-			clearValues[1].depthStencil = {1.0f, 0};
-	
-			renderPassInfo.clearValueCount =
-							static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
-			
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo,
-					VK_SUBPASS_CONTENTS_INLINE);			
+			recordSceneCommandBuffer(i);
+		}
+	}
 	
+	// WARNING: changed by us - was the body of the createCommandBuffers loop; records image i
+	void recordSceneCommandBuffer(size_t i) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = 0; // Optional
+		beginInfo.pInheritanceInfo = nullptr; // Optional
 
+		if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) !=
+					VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		// WARNING: added by us - resets the timestamps of the scene and of the UI buffer submitted after it
+		gpuTimer.reset(commandBuffers[i], i);
+		gpuTimer.beginScene(commandBuffers[i], i);
+		renderStats.beginRecording();
+		
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass; 
+		renderPassInfo.framebuffer = swapChainFramebuffers[i];
+		renderPassInfo.renderArea.offset = {0, 0};
+		renderPassInfo.renderArea.extent = swapChainExtent;
+
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color = initialBackgroundColor;
+		clearValues[1].depthStencil = {1.0f, 0};
+
+		renderPassInfo.clearValueCount =
+						static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
+		
+		if (parallelRecorder.isEnabled()) {
+			// the scene is recorded by the workers, the primary only executes their secondaries
+			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo,
+					VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			const std::vector<VkCommandBuffer>& secondaries = populateCommandBufferParallel(parallelRecorder, (int)i);
+			vkCmdExecuteCommands(commandBuffers[i], static_cast<uint32_t>(secondaries.size()), secondaries.data());
+		} else {
+			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo,
+					VK_SUBPASS_CONTENTS_INLINE);
 			populateCommandBuffer(commandBuffers[i], (int)i);
-            
-			vkCmdEndRenderPass(commandBuffers[i]);
+		}
+        
+		vkCmdEndRenderPass(commandBuffers[i]);
+		gpuTimer.endScene(commandBuffers[i], i);
 
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to record command buffer!");
-			}
+		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
 		}
+		sceneRecorded[i] = true;
+		renderStats.endSceneRecording(i);
 	}
     
+    // the caller must have waited for the fence of the last submission that used this image
+    void updateCommandBufferForScene(uint32_t currentImage) {
+        if (recordSceneEveryFrame || !sceneRecorded[currentImage]) {
+            recordSceneCommandBuffer(currentImage);
+        }
+    }
+    
+    // the caller must have waited for the fence of the last submission that used this image
     void updateCommandBufferForUI(uint32_t currentImage) {
+        if (uiRecorded[currentImage]) {
+            return;
+        }
         
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
-        
-        if (vkAllocateCommandBuffers(device, &allocInfo, &uiCommandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate UI command buffer!");
+        VkCommandBuffer uiCommandBuffer = uiCommandBuffers[currentImage];
+        VkResult result = vkResetCommandBuffer(uiCommandBuffer, 0);
+        if (result != VK_SUCCESS) {
+            PrintVkError(result);
+            throw std::runtime_error("Failed to reset UI command buffer!");
         }
 
         // Begin recording commands in the command buffer
@@ -1683,20 +2153,26 @@ std::cout << "Starting createInstance()\n"  << std::flush;
         renderPassInfo.pClearValues = clearValues.data();
         
 
+        gpuTimer.beginUI(uiCommandBuffer, currentImage);
         // Begin the render pass: the render Area is the UI Surface on the top left
         vkCmdBeginRenderPass(uiCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
         // Redraw the UI
+        renderStats.beginRecording();
         populateDynamicCommandBuffer(uiCommandBuffer, currentImage);
+        renderStats.endUIRecording(currentImage);
 
         // End the render pass
         vkCmdEndRenderPass(uiCommandBuffer);
+        gpuTimer.endUI(uiCommandBuffer, currentImage);
 
         // End the command buffer
         if (vkEndCommandBuffer(uiCommandBuffer) != VK_SUCCESS) {
             throw std::runtime_error("Failed to record command buffer!");
         }
         
+        uiRecorded[currentImage] = true;
+        uiRecordings++;
     }
 
 
@@ -1731,51 +2207,166 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		}
 	}
 	
+    // CPU time to record the scene of one image against the number of recording threads
+    void recordingBenchmark() {
+    	const int repetitions = 20;
+    	buildRecordingBenchmarkScene(recordingBenchmarkObjects);
+    	
+    	unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    	std::vector<unsigned> threadCounts;
+    	for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+    		threadCounts.push_back(threads);
+    	}
+    	threadCounts.push_back(maxThreads);
+    	
+    	std::cout << "\n---- Command recording benchmark: " << recordingBenchmarkObjects << " objects, "
+    			  << repetitions << " recordings per thread count ----\n";
+    	double singleThreadMs = 0.0;
+    	for (unsigned threads : threadCounts) {
+    		ParallelRecorder recorder;
+    		recorder.init(device, findQueueFamilies(physicalDevice).graphicsFamily.value(), threads);
+    		recorder.prepare(renderPass, {swapChainFramebuffers[0]});
+    		populateCommandBufferParallel(recorder, 0);	// warm-up: first use of the buffers and pools
+    		
+    		std::vector<double> times;
+    		for (int r = 0; r < repetitions; r++) {
+    			auto start = std::chrono::high_resolution_clock::now();
+    			populateCommandBufferParallel(recorder, 0);
+    			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    		}
+    		std::sort(times.begin(), times.end());
+    		double medianMs = times[times.size() / 2];
+    		if (threads == 1) singleThreadMs = medianMs;
+    		std::cout << threads << " threads: median " << medianMs << " ms, min " << times.front() << " ms, speed-up "
+    				  << (singleThreadMs / medianMs) << "x\n";
+    		recorder.cleanup();
+    	}
+    	std::cout << "-----------------------------------------------\n\n";
+    }
+	
     void mainLoop() {
+        if (headless) {
+            headlessLoop();
+            return;
+        }
+        soakTest.begin();
         while (!glfwWindowShouldClose(window)){
             glfwPollEvents();
             drawFrame();
+            if (!soakTest.frame(uiRecordings, memoryAllocator) || inputReplay.isFinished()) {
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
+        }
+        
+        vkDeviceWaitIdle(device);
+        soakTest.end(uiRecordings, memoryAllocator);
+    }
+    
+    // WARNING: added by us - draws headlessFrames frames as fast as the device allows, then quits
+    void headlessLoop() {
+        std::cout << "Headless: rendering " << (headlessFrames > 0 ? std::to_string(headlessFrames) : std::string("all the"))
+                  << " frames at " << swapChainExtent.width << "x" << swapChainExtent.height << "\n";
+        soakTest.begin();
+        auto start = std::chrono::high_resolution_clock::now();
+        while (headlessFrames == 0 || headlessFrame < headlessFrames) {
+            drawFrame();
+            if (!soakTest.frame(uiRecordings, memoryAllocator) || inputReplay.isFinished()) {
+                break;
+            }
         }
         
         vkDeviceWaitIdle(device);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "Headless: " << headlessFrame << " frames in " << seconds << " s, "
+                  << (headlessFrame > 0 ? seconds * 1000.0 / headlessFrame : 0.0) << " ms per frame\n";
+        soakTest.end(uiRecordings, memoryAllocator);
+    }
+    
+    // WARNING: added by us - the render counters of the frame go into the replay report next to its timings
+    void reportFrameStats(const RenderStatsFrame& frame) {
+        if (!inputReplay.isTiming()) return;
+        inputReplay.addCount("draw calls", frame.commands.drawCalls);
+        inputReplay.addCount("triangles", (double)frame.triangles);
+        inputReplay.addCount("pipeline binds", frame.commands.pipelineBinds);
+        inputReplay.addCount("descriptor set binds", frame.commands.descriptorSetBinds);
+        inputReplay.addCount("uniform bytes", (double)frame.uniformBytes);
+        inputReplay.addCount("buffers created", frame.buffersCreated);
+        inputReplay.addCount("buffers destroyed", frame.buffersDestroyed);
+        inputReplay.addCount("objects drawn", frame.drawList.drawnObjects);
+        inputReplay.addCount("objects uploaded", frame.drawList.uploadedObjects);
     }
     
     void drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        PROFILE_SCOPE("drawFrame");
+        {
+            PROFILE_SCOPE("fence wait");
+            vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        }
 
         uint32_t imageIndex;
+        VkResult result;
 
-        VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
-                                                imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            recreateSwapChain();
-            return;
-        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("failed to acquire swap chain image!");
+        if (headless) {
+            // WARNING: added by us - no swap chain to acquire from: the offscreen images are used in turn
+            imageIndex = headlessFrame % static_cast<uint32_t>(swapChainImages.size());
+        } else {
+            PROFILE_SCOPE("acquire");
+            result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
+                                           imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                recreateSwapChain();
+                return;
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
         }
 
         if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+            PROFILE_SCOPE("image fence wait");
             vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
         }
         imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+        // WARNING: added by us - the last submission of this image is over: its GPU timings are ready
+        if (gpuTimer.collect(imageIndex)) {
+            const std::vector<GpuTimerSection>& sections = gpuTimer.getSections();
+            for (const GpuTimerSection& section : sections) {
+                if (section.valid) inputReplay.addTime(section.name, section.ms);
+            }
+            // the groups are part of the scene pass, the first two sections are the passes; a frame with
+            // neither pass timed keeps the last GPU time
+            if (sections[0].valid || sections[1].valid) {
+                renderStats.setGpuTime((sections[0].valid ? sections[0].ms : 0.0) + (sections[1].valid ? sections[1].ms : 0.0));
+            }
+        }
 
         // Aggiorna il command buffer dell'UI
         
-        updateUniformBuffer(imageIndex);
-        updateCommandBufferForUI(imageIndex);
+        auto frameStart = std::chrono::high_resolution_clock::now();
+        {
+            PROFILE_SCOPE("update");
+            updateUniformBuffer(imageIndex);
+        }
+        {
+            PROFILE_SCOPE("record");
+            auto recordStart = std::chrono::high_resolution_clock::now();
+            updateCommandBufferForScene(imageIndex);
+            updateCommandBufferForUI(imageIndex);
+            inputReplay.addTime("record", std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count());
+        }
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
         VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
+        // headless, nothing signals an acquired image and nothing waits to present
+        submitInfo.waitSemaphoreCount = headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
         // Usa un array per i command buffer
-        std::array<VkCommandBuffer, 2> submitCommandBuffers = {commandBuffers[imageIndex], uiCommandBuffer};
+        std::array<VkCommandBuffer, 2> submitCommandBuffers = {commandBuffers[imageIndex], uiCommandBuffers[imageIndex]};
 
         submitInfo.commandBufferCount = static_cast<uint32_t>(submitCommandBuffers.size());
         submitInfo.pCommandBuffers = submitCommandBuffers.data();
@@ -1784,13 +2375,36 @@ std::cout << "Starting createInstance()\n"  << std::flush;
         //submitInfo.commandBufferCount = 1;
 
         VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        {
+            PROFILE_SCOPE("submit");
+            vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+            if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+            gpuTimer.submitted(imageIndex);
+        }
+        reportFrameStats(renderStats.endFrame(imageIndex));
+        inputReplay.endFrame(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count());
+
+        if (headless) {
+            if (headlessDumpFrames.count(headlessFrame) > 0) {
+                // the readback is submitted after this frame but not ordered with it
+                vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+                PROFILE_SCOPE("readback");
+                std::string filename = "headless_frame_" + std::to_string(headlessFrame) + ".png";
+                saveScreenshot(filename.c_str(), (int)imageIndex);
+            }
+            headlessFrame++;
+            if (framebufferResized) {
+                framebufferResized = false;
+                recreateSwapChain();
+            }
+            currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+            return;
         }
 
         VkPresentInfoKHR presentInfo{};
@@ -1804,7 +2418,10 @@ std::cout << "Starting createInstance()\n"  << std::flush;
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = nullptr; // Optional
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        {
+            PROFILE_SCOPE("present");
+            result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
             framebufferResized = false;
@@ -1823,14 +2440,17 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	
     void recreateSwapChain() {
     	int width = 0, height = 0;
-		glfwGetFramebufferSize(window, &width, &height);
-		
-		while (width == 0 || height == 0) {
+    	if (!headless) {
 			glfwGetFramebufferSize(window, &width, &height);
-			glfwWaitEvents();
+			
+			while (width == 0 || height == 0) {
+				glfwGetFramebufferSize(window, &width, &height);
+				glfwWaitEvents();
+			}
 		}
 
 		vkDeviceWaitIdle(device);
+		soakTest.swapChainRecreated(uiRecordings, memoryAllocator);
     	
     	cleanupSwapChain();
 
@@ -1843,6 +2463,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		createDescriptorPool();
 
 		pipelinesAndDescriptorSetsInit();
+		pipelineCache.printCreationStats("swap chain recreation");
 
 		createCommandBuffers();
 	}
@@ -1862,6 +2483,8 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		
 		vkFreeCommandBuffers(device, commandPool,
 				static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		vkFreeCommandBuffers(device, commandPool,
+				static_cast<uint32_t>(uiCommandBuffers.size()), uiCommandBuffers.data());
 				
 		pipelinesAndDescriptorSetsCleanup();
 
@@ -1871,7 +2494,15 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			vkDestroyImageView(device, swapChainImageViews[i], nullptr);
 		}
 		
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		if (headless) {
+			for (size_t i = 0; i < swapChainImages.size(); i++) {
+				vkDestroyImage(device, swapChainImages[i], nullptr);
+				vkFreeMemory(device, offscreenImagesMemory[i], nullptr);
+			}
+			offscreenImagesMemory.clear();
+		} else {
+			vkDestroySwapchainKHR(device, swapChain, nullptr);
+		}
 
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
@@ -1888,24 +2519,31 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			vkDestroyFence(device, inFlightFences[i], nullptr);
     	}
     	
+    	parallelRecorder.cleanup();
+    	gpuTimer.cleanup();
+    	pipelineCache.save();
+    	pipelineCache.cleanup();
+    	uploadBatch.cleanup();
+    	memoryAllocator.cleanup();
     	vkDestroyCommandPool(device, commandPool, nullptr);
     	
  		vkDestroyDevice(device, nullptr);
 		
-		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+		if (validationEnabled) {
+			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+		}
 		
-		vkDestroySurfaceKHR(instance, surface, nullptr);
+		if (!headless) {
+			vkDestroySurfaceKHR(instance, surface, nullptr);
+		}
     	vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
-
-        glfwTerminate();
+        if (!headless) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 	
-	void RebuildPipeline() {
-		framebufferResized = true;
-	}
-	
 	
 	// Control Wrapper
     void handleGamePad(int id, glm::vec3& m, glm::vec3& r) {
@@ -1985,6 +2623,22 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 					(currentTime - startTime).count();
 		deltaT = time - lastTime;
 		lastTime = time;
+		
+		// WARNING: added by us - a replay supplies the whole input of the frame
+		inputReplay.beginFrame();
+		if (inputReplay.isPlaying()) {
+			inputReplay.playMotion(deltaT, m, r);
+			if (isKeyPressed(GLFW_KEY_V)) {
+				resetViewSignal.emit({});
+			}
+			return;
+		}
+		
+		// headless there is no keyboard and GLFW is not initialised
+		if (window == nullptr) {
+			inputReplay.recordMotion(deltaT, m, r);
+			return;
+		}
 
         if(glfwGetKey(window, GLFW_KEY_LEFT)) {
             r.y = -1.0f;
@@ -2024,7 +2678,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			m.y = -1.0f;
 		}
         
-        if(glfwGetKey(window, GLFW_KEY_V)) {
+        if(isKeyPressed(GLFW_KEY_V)) {
             resetViewSignal.emit({});
         }
 		
@@ -2032,6 +2686,8 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		handleGamePad(GLFW_JOYSTICK_2,m,r);
 		handleGamePad(GLFW_JOYSTICK_3,m,r);
 		handleGamePad(GLFW_JOYSTICK_4,m,r);
+		
+		inputReplay.recordMotion(deltaT, m, r);
 	}
 	
 	// Public part of the base class
@@ -2321,7 +2977,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			srcImage,
 			VK_ACCESS_MEMORY_READ_BIT,
 			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			presentedImageLayout(),
 			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -2392,7 +3048,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			VK_ACCESS_TRANSFER_READ_BIT,
 			VK_ACCESS_MEMORY_READ_BIT,
 			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			presentedImageLayout(),
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
@@ -2499,6 +3155,158 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 
 // Helper classes
 
+void UploadBatch::init(BaseProject *bp, VkDeviceSize stagingRingSize) {
+	BP = bp;
+	ringSize = stagingRingSize;
+	
+	BP->createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					 ringBuffer, ringMemory);
+	vkMapMemory(BP->device, ringMemory, 0, ringSize, 0, (void **)&ringData);
+	
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = BP->commandPool;
+	allocInfo.commandBufferCount = 1;
+	VkResult result = vkAllocateCommandBuffers(BP->device, &allocInfo, &commandBuffer);
+	if (result != VK_SUCCESS) {
+		PrintVkError(result);
+		throw std::runtime_error("failed to allocate upload command buffer!");
+	}
+	
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	result = vkCreateFence(BP->device, &fenceInfo, nullptr, &fence);
+	if (result != VK_SUCCESS) {
+		PrintVkError(result);
+		throw std::runtime_error("failed to create upload fence!");
+	}
+}
+
+void UploadBatch::beginCommands() {
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkResetCommandBuffer(commandBuffer, 0);
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	recording = true;
+}
+
+void UploadBatch::submitAndWait() {
+	if(!recording) return;
+	
+	// make every transfer of the batch visible to the draws that will read it
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+							VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+						 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+						 1, &barrier, 0, nullptr, 0, nullptr);
+	vkEndCommandBuffer(commandBuffer);
+	recording = false;
+	
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	VkResult result = vkQueueSubmit(BP->graphicsQueue, 1, &submitInfo, fence);
+	if (result != VK_SUCCESS) {
+		PrintVkError(result);
+		throw std::runtime_error("failed to submit upload batch!");
+	}
+	vkWaitForFences(BP->device, 1, &fence, VK_TRUE, UINT64_MAX);
+	vkResetFences(BP->device, 1, &fence);
+	submitCount++;
+	
+	ringHead = 0;
+	for(auto &d : dedicated) {
+		BP->destroyBuffer(d.buffer);
+		vkFreeMemory(BP->device, d.memory, nullptr);
+	}
+	dedicated.clear();
+}
+
+void UploadBatch::begin() {
+	if(depth++ == 0) {
+		submitCount = 0;
+		stagedBytes = 0;
+	}
+}
+
+void UploadBatch::end() {
+	if(depth == 0) {
+		throw std::runtime_error("UploadBatch::end() without begin()");
+	}
+	if(--depth == 0) {
+		submitAndWait();
+		if(submitCount > 1) {
+			std::cout << "Upload batch: " << submitCount << " submissions, "
+					  << (stagedBytes / (1024.0 * 1024.0)) << " MB staged\n";
+		}
+	}
+}
+
+UploadBatch::StagingSlice UploadBatch::stage(VkDeviceSize size, VkDeviceSize alignment) {
+	stagedBytes += size;
+	
+	if(size > ringSize) {
+		DedicatedStaging d;
+		BP->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+						 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+						 d.buffer, d.memory);
+		void *mapped;
+		vkMapMemory(BP->device, d.memory, 0, size, 0, &mapped);
+		dedicated.push_back(d);
+		return {d.buffer, 0, mapped};
+	}
+	
+	VkDeviceSize offset = (ringHead + alignment - 1) / alignment * alignment;
+	if(offset + size > ringSize) {
+		// the ring is full: everything staged so far must reach the GPU before it can be reused
+		submitAndWait();
+		offset = 0;
+	}
+	ringHead = offset + size;
+	return {ringBuffer, offset, ringData + offset};
+}
+
+UploadBatch::StagingSlice UploadBatch::stage(const void *data, VkDeviceSize size, VkDeviceSize alignment) {
+	StagingSlice slice = stage(size, alignment);
+	memcpy(slice.mapped, data, (size_t)size);
+	return slice;
+}
+
+VkCommandBuffer UploadBatch::commands() {
+	if(depth == 0) {
+		throw std::runtime_error("UploadBatch::commands() outside begin() / end()");
+	}
+	if(!recording) {
+		beginCommands();
+	}
+	return commandBuffer;
+}
+
+void UploadBatch::cleanup() {
+	if(ringBuffer != VK_NULL_HANDLE) {
+		vkUnmapMemory(BP->device, ringMemory);
+		BP->destroyBuffer(ringBuffer);
+		vkFreeMemory(BP->device, ringMemory, nullptr);
+		ringBuffer = VK_NULL_HANDLE;
+	}
+	if(fence != VK_NULL_HANDLE) {
+		vkDestroyFence(BP->device, fence, nullptr);
+		fence = VK_NULL_HANDLE;
+	}
+	if(commandBuffer != VK_NULL_HANDLE) {
+		vkFreeCommandBuffers(BP->device, BP->commandPool, 1, &commandBuffer);
+		commandBuffer = VK_NULL_HANDLE;
+	}
+}
+
 
 void VertexDescriptor::init(BaseProject *bp, std::vector<VertexBindingDescriptorElement> B, std::vector<VertexDescriptorElement> E) {
 	BP = bp;
@@ -2612,33 +3420,61 @@ std::vector<VkVertexInputAttributeDescription> VertexDescriptor::getAttributeDes
 
 
 
-void Model::loadModelOBJ(std::string file) {
+void Model::loadModelOBJ(std::string file, std::ostream &log) {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 	std::string warn, err;
 	
-	std::cout << "Loading : " << file << "[OBJ]\n";	
+	log << "Loading : " << file << "[OBJ]\n";	
 	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
 						  file.c_str())) {
 		throw std::runtime_error(warn + err);
 	}
 	
-	std::cout << "Building\n";	
+	log << "Building\n";	
 //	std::cout << "Position " << VD->Position.hasIt << "," << VD->Position.offset << "\n";	
 //	std::cout << "UV " << VD->UV.hasIt << "," << VD->UV.offset << "\n";	
 //	std::cout << "Normal " << VD->Normal.hasIt << "," << VD->Normal.offset << "\n";
 	int mainStride = VD->Bindings[0].stride;
+	
+	// WARNING: added by us - every (position, normal, uv) triplet is emitted only once,
+	// corners that reference an already emitted triplet just reuse its index
+	struct ObjIndexHash {
+		size_t operator()(const tinyobj::index_t &i) const {
+			return MeshCache::hash(&i, sizeof(tinyobj::index_t));
+		}
+	};
+	struct ObjIndexEqual {
+		bool operator()(const tinyobj::index_t &a, const tinyobj::index_t &b) const {
+			return a.vertex_index == b.vertex_index && a.normal_index == b.normal_index &&
+				   a.texcoord_index == b.texcoord_index;
+		}
+	};
+	std::unordered_map<tinyobj::index_t, uint32_t, ObjIndexHash, ObjIndexEqual> uniqueVertices;
+	size_t corners = 0;
+	
 	for (const auto& shape : shapes) {
+		corners += shape.mesh.indices.size();
+		uniqueVertices.reserve(corners);
 		for (const auto& index : shape.mesh.indices) {
-			std::vector<unsigned char> vertex(mainStride, 0);
+			auto found = uniqueVertices.find(index);
+			if(found != uniqueVertices.end()) {
+				indices.push_back(found->second);
+				continue;
+			}
+			
+			uint32_t vertexId = (uint32_t)(vertices.size()/mainStride);
+			vertices.resize(vertices.size() + mainStride, 0);
+			unsigned char *vertex = &vertices[(size_t)vertexId * mainStride];
+			
 			glm::vec3 pos = {
 				attrib.vertices[3 * index.vertex_index + 0],
 				attrib.vertices[3 * index.vertex_index + 1],
 				attrib.vertices[3 * index.vertex_index + 2]
 			};
 			if(VD->Position.hasIt) {
-				glm::vec3 *o = (glm::vec3 *)((char*)(&vertex[0]) + VD->Position.offset);
+				glm::vec3 *o = (glm::vec3 *)((char*)vertex + VD->Position.offset);
 				*o = pos;
 			}
 			
@@ -2648,7 +3484,7 @@ void Model::loadModelOBJ(std::string file) {
 				attrib.colors[3 * index.vertex_index + 2]
 			};
 			if(VD->Color.hasIt) {
-				glm::vec3 *o = (glm::vec3 *)((char*)(&vertex[0]) + VD->Color.offset);
+				glm::vec3 *o = (glm::vec3 *)((char*)vertex + VD->Color.offset);
 				*o = color;
 			}
 			
@@ -2660,35 +3496,39 @@ void Model::loadModelOBJ(std::string file) {
                 };
             }
 			if(VD->UV.hasIt) {
-				glm::vec2 *o = (glm::vec2 *)((char*)(&vertex[0]) + VD->UV.offset);
+				glm::vec2 *o = (glm::vec2 *)((char*)vertex + VD->UV.offset);
 				*o = texCoord;
 			}
 
-			glm::vec3 norm = {
-				attrib.normals[3 * index.normal_index + 0],
-				attrib.normals[3 * index.normal_index + 1],
-				attrib.normals[3 * index.normal_index + 2]
-			};
+			glm::vec3 norm = {0.0f, 0.0f, 0.0f};
+			if (index.normal_index >= 0) {
+				norm = {
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2]
+				};
+			}
 			if(VD->Normal.hasIt) {
-				glm::vec3 *o = (glm::vec3 *)((char*)(&vertex[0]) + VD->Normal.offset);
+				glm::vec3 *o = (glm::vec3 *)((char*)vertex + VD->Normal.offset);
 				*o = norm;
 			}
 			
-			vertices.insert(vertices.end(), vertex.begin(), vertex.end());
-			indices.push_back((int)(vertices.size()/mainStride)-1);
+			uniqueVertices.emplace(index, vertexId);
+			indices.push_back(vertexId);
 		}
 	}
-	std::cout << "[OBJ] Vertices: "<< vertices.size() << "\n";
-	std::cout << "Indices: "<< indices.size() << "\n";
+	log << "[OBJ] Corners: " << corners << ", unique vertices: " << (vertices.size()/mainStride) << "\n";
+	optimizeMesh(log);
+	log << "Indices: "<< indices.size() << "\n";
 	
 }
 
-void Model::loadModelGLTF(std::string file, bool encoded) {
+void Model::loadModelGLTF(std::string file, bool encoded, std::ostream &log) {
 	tinygltf::Model model;
 	tinygltf::TinyGLTF loader;
 	std::string warn, err;
 	
-	std::cout << "Loading : " << file << (encoded ? "[MGCG]" : "[GLTF]") << "\n";	
+	log << "Loading : " << file << (encoded ? "[MGCG]" : "[GLTF]") << "\n";	
 	if(encoded) {
 		auto modelString = readFile(file);
 		
@@ -2718,8 +3558,10 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 		
 		if (!loader.LoadASCIIFromString(&model, &warn, &err, 
 						reinterpret_cast<const char *>(decomp), size, "/")) {
+			free(decomp);
 			throw std::runtime_error(warn + err);
 		}
+		free(decomp);
 	} else {
 		if (!loader.LoadASCIIFromFile(&model, &warn, &err, 
 						file.c_str())) {
@@ -2728,7 +3570,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 	}
 
 	for (const auto& mesh :  model.meshes) {
-		std::cout << "Primitives: " << mesh.primitives.size() << "\n";
+		log << "Primitives: " << mesh.primitives.size() << "\n";
 		for (const auto& primitive :  mesh.primitives) {
 			if (primitive.indices < 0) {
 				continue;
@@ -2760,7 +3602,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 				if(cntPos > cntTot) cntTot = cntPos;
 			} else {
 				if(VD->Position.hasIt) {
-					std::cout << "Warning: vertex layout has position, but file hasn't\n";
+					log << "Warning: vertex layout has position, but file hasn't\n";
 				}
 			}
 			
@@ -2774,7 +3616,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 				if(cntNorm > cntTot) cntTot = cntNorm;
 			} else {
 				if(VD->Normal.hasIt) {
-					std::cout << "Warning: vertex layout has normal, but file hasn't\n";
+					log << "Warning: vertex layout has normal, but file hasn't\n";
 				}
 			}
 
@@ -2788,7 +3630,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 				if(cntTan > cntTot) cntTot = cntTan;
 			} else {
 				if(VD->Tangent.hasIt) {
-					std::cout << "Warning: vertex layout has tangent, but file hasn't\n";
+					log << "Warning: vertex layout has tangent, but file hasn't\n";
 				}
 			}
 
@@ -2802,14 +3644,17 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 				if(cntUV > cntTot) cntTot = cntUV;
 			} else {
 				if(VD->UV.hasIt) {
-					std::cout << "Warning: vertex layout has UV, but file hasn't\n";
+					log << "Warning: vertex layout has UV, but file hasn't\n";
 				}
 			}
 
 			int mainStride = VD->Bindings[0].stride;
+			// WARNING: added by us - the indices of each primitive are relative to its own vertices
+			uint32_t baseVertex = (uint32_t)(vertices.size()/mainStride);
+			vertices.resize(vertices.size() + (size_t)cntTot * mainStride, 0);
 //std::cout << "making vertex array. Stride:" << mainStride << "\n";
 			for(int i = 0; i < cntTot; i++) {
-				std::vector<unsigned char> vertex(mainStride, 0);
+				unsigned char *vertex = &vertices[((size_t)baseVertex + i) * mainStride];
 //std::cout << vertices.size() << "," << vertex.size() << "," << &vertex << " " << &vertex[0] << " ";
 //std::cout << i << "\n";
 				
@@ -2820,7 +3665,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 						bufferPos[3 * i + 2]
 					};
 //std::cout << "Pos: " <<	VD->Position.offset << "\n";
-					glm::vec3 *o = (glm::vec3 *)((char*)(&vertex[0]) + VD->Position.offset);
+					glm::vec3 *o = (glm::vec3 *)((char*)vertex + VD->Position.offset);
 //std::cout << "at: " << o << "\n";
 					*o = pos;
 //std::cout << "Copied: " << o->x << "\n";
@@ -2832,7 +3677,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 						bufferNormals[3 * i + 2]
 					};
 //std::cout << "Nor: " <<	VD->Normal.offset << "\n";
-					glm::vec3 *o = (glm::vec3 *)((char*)(&vertex[0]) + VD->Normal.offset);
+					glm::vec3 *o = (glm::vec3 *)((char*)vertex + VD->Normal.offset);
 					*o = normal;
 				}
 
@@ -2844,7 +3689,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 						bufferTangents[4 * i + 3]
 					};
 //std::cout << "Tan: " <<	VD->Tangent.offset << "\n";
-					glm::vec4 *o = (glm::vec4 *)((char*)(&vertex[0]) + VD->Tangent.offset);
+					glm::vec4 *o = (glm::vec4 *)((char*)vertex + VD->Tangent.offset);
 					*o = tangent;
 				}
 				
@@ -2854,13 +3699,10 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 						bufferTexCoords[2 * i + 1] 
 					};
 //std::cout << "UV : " <<	VD->UV.offset << "\n";
-					glm::vec2 *o = (glm::vec2 *)((char*)(&vertex[0]) + VD->UV.offset);
+					glm::vec2 *o = (glm::vec2 *)((char*)vertex + VD->UV.offset);
 					*o = texCoord;
 				}
 
-//std::cout << vertices.size() << "," << vertex.size() << " Inserting\n";
-				vertices.insert(vertices.end(), vertex.begin(), vertex.end());
-//std::cout << vertices.size() << " Inserted\n";
 			} 
 
 			const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
@@ -2872,7 +3714,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 					{
 						const uint16_t *bufferIndex = reinterpret_cast<const uint16_t *>(&(buffer.data[accessor.byteOffset + bufferView.byteOffset]));
 						for(int i = 0; i < accessor.count; i++) {
-							indices.push_back(bufferIndex[i]);
+							indices.push_back(baseVertex + bufferIndex[i]);
 						}
 					}
 					break;
@@ -2880,7 +3722,7 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 					{
 						const uint32_t *bufferIndex = reinterpret_cast<const uint32_t *>(&(buffer.data[accessor.byteOffset + bufferView.byteOffset]));
 						for(int i = 0; i < accessor.count; i++) {
-							indices.push_back(bufferIndex[i]);
+							indices.push_back(baseVertex + bufferIndex[i]);
 						}
 					}
 					break;
@@ -2891,38 +3733,65 @@ void Model::loadModelGLTF(std::string file, bool encoded) {
 		}
 	}
 
-	std::cout << (encoded ? "[MGCG]" : "[GLTF]") << " Vertices: " << vertices.size()
-			  << "\nIndices: " << indices.size() << "\n";
+	log << (encoded ? "[MGCG]" : "[GLTF]") << " Vertices: " << (vertices.size()/VD->Bindings[0].stride) << "\n";
+	optimizeMesh(log);
+	log << "Indices: " << indices.size() << "\n";
+}
+
+// WARNING: added by us - merges duplicated vertices and reorders the mesh for the vertex caches
+void Model::optimizeMesh(std::ostream &log) {
+	MeshOptimizerStats stats = MeshOptimizer::optimize(vertices, indices, VD->Bindings[0].stride);
+	log << "Optimized: vertices " << stats.verticesBefore << " -> " << stats.verticesAfter
+		<< ", ACMR " << stats.acmrBefore << " -> " << stats.acmrAfter << "\n";
 }
 
+// Identifies the vertex layout the baked mesh cache entries were built for
+uint64_t Model::vertexLayoutHash() {
+	uint64_t h = MeshCache::FNV_OFFSET;
+	for(const auto &b : VD->Bindings) {
+		uint32_t fields[3] = {b.binding, b.stride, (uint32_t)b.inputRate};
+		h = MeshCache::hash(fields, sizeof(fields), h);
+	}
+	for(const auto &e : VD->Layout) {
+		uint32_t fields[6] = {e.binding, e.location, (uint32_t)e.format, e.offset, e.size, (uint32_t)e.usage};
+		h = MeshCache::hash(fields, sizeof(fields), h);
+	}
+	return h;
+}
+
+// WARNING: changed by us - vertex and index buffers live in device local memory,
+// filled through the upload batch (updateMesh still replaces them with host visible ones)
 void Model::createVertexBuffer() {
 //	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 	VkDeviceSize bufferSize = vertices.size();
 
-	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-						VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+						VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+						VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 						vertexBuffer, vertexBufferMemory);
     
-        
-    void* data;
-	vkMapMemory(BP->device, vertexBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t) bufferSize);
-	vkUnmapMemory(BP->device, vertexBufferMemory);
+	UploadBatch &batch = BP->uploadBatch;
+	UploadBatchScope uploads(batch);
+	UploadBatch::StagingSlice slice = batch.stage(vertices.data(), bufferSize);
+	VkBufferCopy copyRegion{slice.offset, 0, bufferSize};
+	vkCmdCopyBuffer(batch.commands(), slice.buffer, vertexBuffer, 1, &copyRegion);
+	uploads.end();
 }
 
 void Model::createIndexBuffer() {
 	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
     
-	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-							 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-							 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+							 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 							 indexBuffer, indexBufferMemory);
         
-	void* data;
-	vkMapMemory(BP->device, indexBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t) bufferSize);
-	vkUnmapMemory(BP->device, indexBufferMemory);
+	UploadBatch &batch = BP->uploadBatch;
+	UploadBatchScope uploads(batch);
+	UploadBatch::StagingSlice slice = batch.stage(indices.data(), bufferSize);
+	VkBufferCopy copyRegion{slice.offset, 0, bufferSize};
+	vkCmdCopyBuffer(batch.commands(), slice.buffer, indexBuffer, 1, &copyRegion);
+	uploads.end();
 }
 
 
@@ -2950,23 +3819,21 @@ void Model::updateVertexBuffer() {
     
     replaceVertexBuffer(bufferSize);
     
-    void* data;
-    vkMapMemory(BP->device, vertexBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t) bufferSize);
-    vkUnmapMemory(BP->device, vertexBufferMemory);
+    memcpy(vertexBufferMemory.mapped, vertices.data(), (size_t) bufferSize);
+    BP->memoryAllocator.flush(vertexBufferMemory, 0, bufferSize);
 }
 
 void Model::replaceVertexBuffer(VkDeviceSize newSize) {
     // Create new buffer
     VkBuffer newVertexBuffer;
-    VkDeviceMemory newVertexBufferMemory;
+    MemoryAllocation newVertexBufferMemory;
 
     BP->createBuffer(newSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, newVertexBuffer, newVertexBufferMemory);
 
 
     // Update references
     VkBuffer oldVertexBuffer = vertexBuffer;
-    VkDeviceMemory oldVertexBufferMemory = vertexBufferMemory;
+    MemoryAllocation oldVertexBufferMemory = vertexBufferMemory;
     vertexBuffer = newVertexBuffer;
     vertexBufferMemory = newVertexBufferMemory;
 
@@ -3000,7 +3867,7 @@ void Model::replaceVertexBuffer(VkDeviceSize newSize) {
         vkQueueSubmit(BP->graphicsQueue, 1, &submitInfo, fence);
 
         // Store old resources and fence
-        pendingResources.push_back({oldVertexBuffer, oldVertexBufferMemory, fence});
+        pendingResources.push_back({oldVertexBuffer, oldVertexBufferMemory, fence, commandBuffer});
     }
 
 }
@@ -3010,16 +3877,14 @@ void Model::updateIndexBuffer() {
     
     replaceIndexBuffer(bufferSize);
         
-    void* data;
-    vkMapMemory(BP->device, indexBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t) bufferSize);
-    vkUnmapMemory(BP->device, indexBufferMemory);
+    memcpy(indexBufferMemory.mapped, indices.data(), (size_t) bufferSize);
+    BP->memoryAllocator.flush(indexBufferMemory, 0, bufferSize);
 }
 
 void Model::replaceIndexBuffer(VkDeviceSize newSize) {
     // Create new buffer
     VkBuffer newIndexBuffer;
-    VkDeviceMemory newIndexBufferMemory;
+    MemoryAllocation newIndexBufferMemory;
 
     BP->createBuffer(newSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
@@ -3028,7 +3893,7 @@ void Model::replaceIndexBuffer(VkDeviceSize newSize) {
 
     // Update references
     VkBuffer oldIndexBuffer = indexBuffer;
-    VkDeviceMemory oldIndexBufferMemory = indexBufferMemory;
+    MemoryAllocation oldIndexBufferMemory = indexBufferMemory;
     indexBuffer = newIndexBuffer;
     indexBufferMemory = newIndexBufferMemory;
 
@@ -3062,7 +3927,7 @@ void Model::replaceIndexBuffer(VkDeviceSize newSize) {
         vkQueueSubmit(BP->graphicsQueue, 1, &submitInfo, fence);
 
         // Store old resources and fence
-        pendingResources.push_back({oldIndexBuffer, oldIndexBufferMemory, fence});
+        pendingResources.push_back({oldIndexBuffer, oldIndexBufferMemory, fence, commandBuffer});
     }
 
 }
@@ -3072,9 +3937,10 @@ void Model::destroyPendingResources() {
     for (auto it = pendingResources.begin(); it != pendingResources.end();) {
         VkResult result = vkGetFenceStatus(BP->device, it->fence);
         if (result == VK_SUCCESS) {
-            vkDestroyBuffer(BP->device, it->buffer, nullptr);
-            vkFreeMemory(BP->device, it->memory, nullptr);
+            BP->destroyBuffer(it->buffer);
+            BP->memoryAllocator.free(it->memory);
             vkDestroyFence(BP->device, it->fence, nullptr);
+            vkFreeCommandBuffers(BP->device, BP->commandPool, 1, &it->commandBuffer);
             it = pendingResources.erase(it);
         } else {
             ++it;
@@ -3083,23 +3949,53 @@ void Model::destroyPendingResources() {
 }
 
 void Model::init(BaseProject *bp, VertexDescriptor *vd, std::string modelName, std::string file, ModelType MT) {
+	load(bp, vd, modelName, file, MT);
+	upload();
+}
+
+// WARNING: added by us - CPU only (no Vulkan calls), so it can run on a loader thread
+void Model::load(BaseProject *bp, VertexDescriptor *vd, std::string modelName, std::string file, ModelType MT, std::ostream &log) {
 	BP = bp;
 	VD = vd;
-	if(MT == OBJ) {
-		loadModelOBJ(file);
-	} else if(MT == GLTF) {
-		loadModelGLTF(file, false);
-	} else if(MT == MGCG) {
-		loadModelGLTF(file, true);
-	}
 	
-	createVertexBuffer();
-	createIndexBuffer();
+	// WARNING: added by us - use the baked mesh if its source did not change, rebuild it otherwise
+	MeshCacheKey cacheKey = MeshCache::makeKey(file, VD->Bindings[0].stride, vertexLayoutHash());
+	if(MeshCache::load(cacheKey, vertices, indices)) {
+		log << "Loading : " << file << "[CACHE] Vertices: " << (vertices.size()/VD->Bindings[0].stride)
+			<< ", Indices: " << indices.size() << "\n";
+	} else {
+		if(MT == OBJ) {
+			loadModelOBJ(file, log);
+		} else if(MT == GLTF) {
+			loadModelGLTF(file, false, log);
+		} else if(MT == MGCG) {
+			loadModelGLTF(file, true, log);
+		}
+		if(!MeshCache::store(cacheKey, vertices, indices)) {
+			log << "Mesh cache: could not write " << cacheKey.cachePath << "\n";
+		}
+	}
     
     // WARNING: added by me
     type = MT;
     name = modelName;
     fileName = file;
+    
+    computeBounds();
+}
+
+// WARNING: added by us - must be called by the thread that owns the Vulkan queue
+void Model::upload() {
+	createVertexBuffer();
+	createIndexBuffer();
+}
+
+// WARNING: added by us - drops the decoded mesh of a model that will not be uploaded
+void Model::releaseDecoded() {
+	vertices.clear();
+	vertices.shrink_to_fit();
+	indices.clear();
+	indices.shrink_to_fit();
 }
 
 void Model::cleanup() {
@@ -3108,26 +4004,59 @@ void Model::cleanup() {
         destroyPendingResources();
         
         if (vertexBuffer != VK_NULL_HANDLE) {
-            vkDestroyBuffer(BP->device, vertexBuffer, nullptr);
+            BP->destroyBuffer(vertexBuffer);
             vertexBuffer = VK_NULL_HANDLE;
         }
-        if (vertexBufferMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(BP->device, vertexBufferMemory, nullptr);
-            vertexBufferMemory = VK_NULL_HANDLE;
-        }
+        BP->memoryAllocator.free(vertexBufferMemory);
         if (indexBuffer != VK_NULL_HANDLE) {
-            vkDestroyBuffer(BP->device, indexBuffer, nullptr);
+            BP->destroyBuffer(indexBuffer);
             indexBuffer = VK_NULL_HANDLE;
         }
-        if (indexBufferMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(BP->device, indexBufferMemory, nullptr);
-            indexBufferMemory = VK_NULL_HANDLE;
-        }
+        BP->memoryAllocator.free(indexBufferMemory);
         
         clean = true;
     }
 }
 
+ModelMeshView Model::getMeshView() {
+	if(!VD->Position.hasIt) {
+		throw std::runtime_error("Model " + name + " has no vertex positions");
+	}
+	uint32_t stride = VD->Bindings[0].stride;
+	ModelMeshView view;
+	view.positions = vertices.data() + VD->Position.offset;
+	view.positionStride = stride;
+	view.vertexCount = (uint32_t)(vertices.size() / stride);
+	view.indices = indices.data();
+	view.indexCount = (uint32_t)indices.size();
+	return view;
+}
+
+// WARNING: added by us - AABB of the positions, and the sphere centered on it enclosing all of them
+void Model::computeBounds() {
+	if(!VD->Position.hasIt || vertices.empty()) return;
+	ModelMeshView view = getMeshView();
+	
+	glm::vec3 position;
+	memcpy(&position, view.positions, sizeof(glm::vec3));
+	boundsMin = boundsMax = position;
+	for(uint32_t v = 1; v < view.vertexCount; v++) {
+		memcpy(&position, view.positions + (size_t)v * view.positionStride, sizeof(glm::vec3));
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+	boundsCenter = (boundsMin + boundsMax) * 0.5f;
+	boundsExtent = (boundsMax - boundsMin) * 0.5f;
+	
+	float radiusSquared = 0.0f;
+	for(uint32_t v = 0; v < view.vertexCount; v++) {
+		memcpy(&position, view.positions + (size_t)v * view.positionStride, sizeof(glm::vec3));
+		glm::vec3 d = position - boundsCenter;
+		radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+	}
+	boundsRadius = std::sqrt(radiusSquared);
+}
+
 void Model::bind(VkCommandBuffer commandBuffer) {
 	VkBuffer vertexBuffers[] = {vertexBuffer};
 	// property .vertexBuffer of models, contains the VkBuffer handle to its vertex buffer
@@ -3138,20 +4067,20 @@ void Model::bind(VkCommandBuffer commandBuffer) {
 							VK_INDEX_TYPE_UINT32);
 }
 
-void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
-    int texWidth = 0, texHeight = 0, texChannels;
+// WARNING: added by us - CPU only (no Vulkan calls), so it can run on a loader thread
+void Texture::loadPixels(std::string files[], std::ostream &log) {
+    int texChannels;
 	int curWidth = -1, curHeight = -1, curChannels = -1;
-	stbi_uc* pixels[maxImgs];
 	
 	for(int i = 0; i < imgs; i++) {
 	 	pixels[i] = stbi_load(files[i].c_str(), &texWidth, &texHeight,
 						&texChannels, STBI_rgb_alpha);
 		if (!pixels[i]) {
-			std::cout << "Not found: " << files[i] << "\n";
+			log << "Not found: " << files[i] << "\n";
 			throw std::runtime_error("failed to load texture image!");
 		}
-		std::cout << "[" << i << "]" << files[i] << " -> size: " << texWidth
-				  << "x" << texHeight << ", ch: " << texChannels <<"\n";
+		log << "[" << i << "]" << files[i] << " -> size: " << texWidth
+			<< "x" << texHeight << ", ch: " << texChannels <<"\n";
 				  
 		if(i == 0) {
 			curWidth = texWidth;
@@ -3165,27 +4094,28 @@ void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R
 			}
 		}
 	}
-	
+}
+
+void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
+	loadPixels(files);
+	createTextureImage(Fmt);
+}
+
+// Uploads the images decoded by loadPixels, then releases them
+void Texture::createTextureImage(VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
 	VkDeviceSize imageSize = texWidth * texHeight * 4;
 	VkDeviceSize totalImageSize = texWidth * texHeight * 4 * imgs;
 	mipLevels = static_cast<uint32_t>(std::floor(
 					std::log2(std::max(texWidth, texHeight)))) + 1;
 	
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	 
-	BP->createBuffer(totalImageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	  						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-	  						VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	  						stagingBuffer, stagingBufferMemory);
-	void* data;
-	vkMapMemory(BP->device, stagingBufferMemory, 0, totalImageSize, 0, &data);
+	UploadBatch &batch = BP->uploadBatch;
+	UploadBatchScope uploads(batch);
+	UploadBatch::StagingSlice slice = batch.stage(totalImageSize);
 	for(int i = 0; i < imgs; i++) {
-		memcpy(static_cast<char *>(data) + imageSize * i, pixels[i], static_cast<size_t>(imageSize));
+		memcpy(static_cast<char *>(slice.mapped) + imageSize * i, pixels[i], static_cast<size_t>(imageSize));
 		stbi_image_free(pixels[i]);
+		pixels[i] = nullptr;
 	}
-	vkUnmapMemory(BP->device, stagingBufferMemory);
-	
 	
 	BP->createImage(texWidth, texHeight, mipLevels, imgs, VK_SAMPLE_COUNT_1_BIT, Fmt,
 				VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
@@ -3194,16 +4124,15 @@ void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage,
 				textureImageMemory);
 				
-	BP->transitionImageLayout(textureImage, Fmt,
+	VkCommandBuffer commandBuffer = batch.commands();
+	BP->recordImageLayoutTransition(commandBuffer, textureImage, Fmt,
 			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, imgs);
-	BP->copyBufferToImage(stagingBuffer, textureImage,
+	BP->recordCopyBufferToImage(commandBuffer, slice.buffer, slice.offset, textureImage,
 			static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), imgs);
 
-	BP->generateMipmaps(textureImage, Fmt,
+	BP->recordGenerateMipmaps(commandBuffer, textureImage, Fmt,
 					texWidth, texHeight, mipLevels, imgs);
-
-	vkDestroyBuffer(BP->device, stagingBuffer, nullptr);
-	vkFreeMemory(BP->device, stagingBufferMemory, nullptr);
+	uploads.end();
 }
 
 void Texture::createTextureImageView(VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
@@ -3212,7 +4141,7 @@ void Texture::createTextureImageView(VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
 									   VK_IMAGE_ASPECT_COLOR_BIT,
 									   mipLevels,
 									   imgs == 6 ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D,
-									   imgs);
+									   imgs, swizzle);
 }
 	
 void Texture::createTextureSampler(
@@ -3254,16 +4183,107 @@ void Texture::createTextureSampler(
 
 
 void Texture::init(BaseProject *bp, std::string file, VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB, bool initSampler = true) {
-	std::string files[1] = {file};
+	load(bp, file, Fmt);
+	upload(initSampler);
+}
+
+// WARNING: added by us - init split in a CPU decode step (any thread) and a GPU upload step
+void Texture::load(BaseProject *bp, std::string file, VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB, std::ostream &log = std::cout) {
 	BP = bp;
 	imgs = 1;
-	createTextureImage(files, Fmt);
-	createTextureImageView(Fmt);
+	imageFormat = Fmt;
+	if(Fmt == VK_FORMAT_R8G8B8A8_SRGB || Fmt == VK_FORMAT_R8G8B8A8_UNORM) {
+		loadBaked(file, log);
+	} else {
+		std::string files[1] = {file};
+		loadPixels(files, log);
+	}
+}
+
+void Texture::upload(bool initSampler = true) {
+	if(!baked.empty()) {
+		createBakedTextureImage();
+	} else {
+		createTextureImage(imageFormat);
+	}
+	createTextureImageView(imageFormat);
 	if(initSampler) {
 		createTextureSampler();
 	}
 }
 
+// WARNING: added by us - frees the images decoded by load for a texture that will not be uploaded
+void Texture::releaseDecoded() {
+	for(int i = 0; i < maxImgs; i++) {
+		if(pixels[i]) {
+			stbi_image_free(pixels[i]);
+			pixels[i] = nullptr;
+		}
+	}
+	baked.release();
+}
+
+// Reads the baked mip chain from the texture cache, or builds (and stores) it if missing or stale
+void Texture::loadBaked(std::string file, std::ostream &log) {
+	bool srgb = (imageFormat == VK_FORMAT_R8G8B8A8_SRGB);
+	TextureCacheKey cacheKey = TextureCache::makeKey(file, srgb);
+	if(TextureCache::load(cacheKey, baked)) {
+		log << file << " [CACHE] -> size: " << baked.width << "x" << baked.height
+			<< ", ch: " << baked.channels << ", mips: " << baked.mipLevels() << "\n";
+		return;
+	}
+	
+	baked = TextureCache::bake(file, srgb);
+	log << file << " -> size: " << baked.width << "x" << baked.height
+		<< ", ch: " << baked.channels << ", mips: " << baked.mipLevels() << "\n";
+	if(!TextureCache::store(cacheKey, baked)) {
+		log << "Texture cache: could not write " << cacheKey.cachePath << "\n";
+	}
+}
+
+// Uploads the baked mip chain as-is: no decoding and no blits
+void Texture::createBakedTextureImage() {
+	bool srgb = (imageFormat == VK_FORMAT_R8G8B8A8_SRGB);
+	
+	// gray and gray + alpha textures are kept narrow, the view swizzle rebuilds rgba for the shaders
+	if(baked.channels != 4) {
+		VkFormat narrow = (baked.channels == 1) ?
+				(srgb ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM) :
+				(srgb ? VK_FORMAT_R8G8_SRGB : VK_FORMAT_R8G8_UNORM);
+		VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+										VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(BP->physicalDevice, narrow, &formatProperties);
+		
+		if((formatProperties.optimalTilingFeatures & required) == required) {
+			imageFormat = narrow;
+			VkComponentSwizzle alpha = (baked.channels == 1) ? VK_COMPONENT_SWIZZLE_ONE : VK_COMPONENT_SWIZZLE_G;
+			swizzle = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, alpha};
+		} else {
+			TextureCache::expandToRGBA(baked);
+		}
+	}
+	
+	mipLevels = baked.mipLevels();
+	
+	BP->createImage(baked.width, baked.height, mipLevels, 1, VK_SAMPLE_COUNT_1_BIT, imageFormat,
+				VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage,
+				textureImageMemory);
+	
+	UploadBatch &batch = BP->uploadBatch;
+	UploadBatchScope uploads(batch);
+	UploadBatch::StagingSlice slice = batch.stage(baked.data.data(), baked.data.size());
+	VkCommandBuffer commandBuffer = batch.commands();
+	BP->recordImageLayoutTransition(commandBuffer, textureImage, imageFormat,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, 1);
+	BP->recordCopyBufferToImageMips(commandBuffer, slice.buffer, slice.offset, textureImage, baked.mips);
+	BP->recordImageLayoutTransition(commandBuffer, textureImage, imageFormat,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels, 1);
+	uploads.end();
+	baked.release();
+}
+
 
 void Texture::initCubic(BaseProject *bp, std::string files[6]) {
 	BP = bp;
@@ -3279,7 +4299,7 @@ void Texture::cleanup() {
         vkDestroySampler(BP->device, textureSampler, nullptr);
         vkDestroyImageView(BP->device, textureImageView, nullptr);
         vkDestroyImage(BP->device, textureImage, nullptr);
-        vkFreeMemory(BP->device, textureImageMemory, nullptr);
+        BP->memoryAllocator.free(textureImageMemory);
         clean = true;
     }
 }
@@ -3484,12 +4504,16 @@ void Pipeline::create() {
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 	pipelineInfo.basePipelineIndex = -1; // Optional
 	
-	result = vkCreateGraphicsPipelines(BP->device, VK_NULL_HANDLE, 1,
+	// WARNING: changed by us - goes through the shared pipeline cache, and is timed
+	auto createStart = std::chrono::high_resolution_clock::now();
+	result = vkCreateGraphicsPipelines(BP->device, BP->pipelineCache.get(), 1,
 			&pipelineInfo, nullptr, &graphicsPipeline);
 	if (result != VK_SUCCESS) {
 	 	PrintVkError(result);
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
+	BP->pipelineCache.recordCreation(std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - createStart).count());
 	
 }
 
@@ -3573,8 +4597,15 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
 				VkDeviceSize bufferSize = E[j].size;
 				BP->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-									 	 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-									 	 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+									 	 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+									 	 uniformBuffers[j][i], uniformBuffersMemory[j][i]);
+			}
+			toFree[j] = true;
+		} else if(E[j].type == STORAGE) {
+			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
+				VkDeviceSize bufferSize = E[j].size;
+				BP->createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+									 	 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
 									 	 uniformBuffers[j][i], uniformBuffersMemory[j][i]);
 			}
 			toFree[j] = true;
@@ -3605,7 +4636,7 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 		std::vector<VkDescriptorBufferInfo> bufferInfo(E.size());
 		std::vector<VkDescriptorImageInfo> imageInfo(E.size());
 		for (int j = 0; j < E.size(); j++) {
-			if(E[j].type == UNIFORM) {
+			if(E[j].type == UNIFORM || E[j].type == STORAGE) {
 				bufferInfo[j].buffer = uniformBuffers[j][i];
 				bufferInfo[j].offset = 0;
 				bufferInfo[j].range = E[j].size;
@@ -3614,7 +4645,9 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 				descriptorWrites[j].dstSet = descriptorSets[i];
 				descriptorWrites[j].dstBinding = E[j].binding;
 				descriptorWrites[j].dstArrayElement = 0;
-				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				descriptorWrites[j].descriptorType = E[j].type == STORAGE ?
+											VK_DESCRIPTOR_TYPE_STORAGE_BUFFER :
+											VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 				descriptorWrites[j].descriptorCount = 1;
 				descriptorWrites[j].pBufferInfo = &bufferInfo[j];
 			} else if(E[j].type == TEXTURE) {
@@ -3642,8 +4675,8 @@ void DescriptorSet::cleanup() {
 	for(int j = 0; j < uniformBuffers.size(); j++) {
 		if(toFree[j]) {
 			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
-				vkDestroyBuffer(BP->device, uniformBuffers[j][i], nullptr);
-				vkFreeMemory(BP->device, uniformBuffersMemory[j][i], nullptr);
+				BP->destroyBuffer(uniformBuffers[j][i]);
+				BP->memoryAllocator.free(uniformBuffersMemory[j][i]);
 			}
 		}
 	}
@@ -3657,11 +4690,10 @@ void DescriptorSet::bind(VkCommandBuffer commandBuffer, Pipeline &P, int setId,
 					0, nullptr);
 }
 
+// WARNING: changed by us - uniform buffers stay mapped for their whole life (see MemoryAllocator)
 void DescriptorSet::map(int currentImage, void *src, int size, int slot) {
-	void* data;
-
-	vkMapMemory(BP->device, uniformBuffersMemory[slot][currentImage], 0,
-						size, 0, &data);
-	memcpy(data, src, size);
-	vkUnmapMemory(BP->device, uniformBuffersMemory[slot][currentImage]);	
+	MemoryAllocation &memory = uniformBuffersMemory[slot][currentImage];
+	memcpy(memory.mapped, src, size);
+	BP->memoryAllocator.flush(memory, 0, size);
+	BP->renderStats.addUniformBytes(size);
 }
@@ -39,6 +39,20 @@ struct TextVertex
     glm::vec2 texCoord;
 };
 
+// glyphs that fit in one frame of the ring vertex buffer, for all the texts together
+const int TEXT_MAX_GLYPHS = 256;
+// characters reserved for every line, so that changing a text never reallocates it
+const size_t TEXT_LINE_CAPACITY = 64;
+
+/*
+ Batched text renderer: every HUD text shares one pipeline, one font atlas and one draw call.
+ The glyph quads of all the texts live in a persistently mapped vertex buffer split into one region per
+ swap chain image (a ring, indexed by the image being recorded), drawn through a static quad index
+ buffer and an indirect command holding the glyph count. setText only changes the CPU copy of the string;
+ update() writes the quads into the region of the current image (its previous frame has been waited
+ for) when it is older than the texts, so changing a text allocates nothing and never touches the
+ command buffers.
+ */
 struct TextMaker
 {
     VertexDescriptor VD;
@@ -47,28 +61,62 @@ struct TextMaker
 
     DescriptorSetLayout DSL;
     Pipeline P;
-    Model M;
     Texture T;
     DescriptorSet DS;
 
-    std::vector<SingleText> *Texts;
-
-    void init(BaseProject *_BP, std::vector<SingleText> *_Texts)
+    std::vector<SingleText> Texts;
+
+    int maxGlyphs;
+    int fontId = 1;             // index in Fonts
+    uint32_t regionCount = 0;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    MemoryAllocation vertexBufferMemory;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    MemoryAllocation indexBufferMemory;
+    VkBuffer indirectBuffer = VK_NULL_HANDLE;
+    MemoryAllocation indirectBufferMemory;
+
+    // texts version, and the version each ring region was written with
+    uint64_t version = 1;
+    std::vector<uint64_t> regionVersions;
+    // glyphs written in each ring region, for the render stats
+    std::vector<uint32_t> regionGlyphs;
+
+    void init(BaseProject *_BP, int _maxGlyphs = TEXT_MAX_GLYPHS, int _fontId = 1)
     {
         BP = _BP;
-        Texts = _Texts;
+        maxGlyphs = _maxGlyphs;
+        fontId = _fontId;
+        Texts.reserve(8);
         createTextDescriptorSetAndVertexLayout();
         createTextPipeline();
-        createTextModelAndTexture();
+        createTextTexture();
+        createTextBuffers((uint32_t)BP->swapChainImages.size());
+    }
+
+    // returns the id used by setText; call it before the first frame
+    int addText(const std::string &text, glm::vec2 position)
+    {
+        Texts.push_back({1, {}, 0, 0, position});
+        // reserved in place: copying a string does not keep its capacity
+        for (std::string &line : Texts.back().l)
+        {
+            line.reserve(TEXT_LINE_CAPACITY);
+        }
+        Texts.back().l[0] = text;
+        version++;
+        return (int)Texts.size() - 1;
     }
-    
-    void changeText(std::vector<SingleText> *_Texts)
+
+    void setText(int id, const char *text)
     {
-        M.indices.clear();
-        M.vertices.clear();
-        Texts = _Texts;
-        createTextMesh();
-        M.updateMesh(BP, &VD);
+        std::string &line = Texts[id].l[0];
+        if (line == text)
+        {
+            return;
+        }
+        line = text;
+        version++;
     }
 
     void createTextDescriptorSetAndVertexLayout()
@@ -85,29 +133,66 @@ struct TextMaker
                               VK_CULL_MODE_NONE, true);
     }
 
-    void createTextModelAndTexture()
+    void createTextTexture()
     {
-        createTextMesh();
-
-        M.initMesh(BP, &VD);
-
+        UploadBatchScope uploads(BP->getUploadBatch());
         T.init(BP, "textures/Fonts.png");
+        uploads.end();
     }
 
-    void createTextMesh()
+    // one vertex region and one indirect command per swap chain image, the quad indices are shared
+    void createTextBuffers(uint32_t imageCount)
     {
-        int totLen = 0;
-        for (auto &Txt : *Texts)
+        regionCount = imageCount;
+        regionVersions.assign(regionCount, 0);
+        regionGlyphs.assign(regionCount, 0);
+
+        VkDeviceSize regionSize = sizeof(TextVertex) * 4 * maxGlyphs;
+        BP->createBuffer(regionSize * regionCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vertexBuffer, vertexBufferMemory);
+        BP->createBuffer(sizeof(uint32_t) * 6 * maxGlyphs, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indexBuffer, indexBufferMemory);
+        BP->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * regionCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indirectBuffer, indirectBufferMemory);
+
+        uint32_t *indices = (uint32_t *)indexBufferMemory.mapped;
+        for (int k = 0; k < maxGlyphs; k++)
         {
-            for (int i = 0; i < Txt.usedLines; i++)
-            {
-                totLen += Txt.l[i].length();
-            }
+            // two triangles per glyph
+            indices[6 * k + 0] = 4 * k + 0;
+            indices[6 * k + 1] = 4 * k + 1;
+            indices[6 * k + 2] = 4 * k + 2;
+            indices[6 * k + 3] = 4 * k + 1;
+            indices[6 * k + 4] = 4 * k + 2;
+            indices[6 * k + 5] = 4 * k + 3;
+        }
+        BP->memoryAllocator.flush(indexBufferMemory, 0, sizeof(uint32_t) * 6 * maxGlyphs);
+
+        VkDrawIndexedIndirectCommand *commands = (VkDrawIndexedIndirectCommand *)indirectBufferMemory.mapped;
+        for (uint32_t i = 0; i < regionCount; i++)
+        {
+            commands[i] = {};
+            commands[i].instanceCount = 1;
+            commands[i].vertexOffset = (int32_t)(i * 4 * maxGlyphs);
         }
+        BP->memoryAllocator.flush(indirectBufferMemory, 0, sizeof(VkDrawIndexedIndirectCommand) * regionCount);
+    }
 
-        M.indices.resize(6 * totLen);
+    void destroyTextBuffers()
+    {
+        BP->destroyBuffer(vertexBuffer);
+        BP->destroyBuffer(indexBuffer);
+        BP->destroyBuffer(indirectBuffer);
+        BP->memoryAllocator.free(vertexBufferMemory);
+        BP->memoryAllocator.free(indexBufferMemory);
+        BP->memoryAllocator.free(indirectBufferMemory);
+        vertexBuffer = indexBuffer = indirectBuffer = VK_NULL_HANDLE;
+    }
 
-        int FontId = 1;
+    // writes the glyph quads of all the texts into the region of the given image, returns the glyph count
+    uint32_t writeTextQuads(uint32_t region)
+    {
+        TextVertex *V = (TextVertex *)vertexBufferMemory.mapped + (size_t)region * 4 * maxGlyphs;
 
         float PtoTsx = 2.0f / 800.0f;
         float PtoTsy = 2.0f / 600.0f;
@@ -117,10 +202,10 @@ struct TextMaker
         int texW = 1024;
         int texH = 512;
 
-        int ib = 0, k = 0;
-        for (auto &Txt : *Texts)
+        int k = 0;
+        for (auto &Txt : Texts)
         {
-            Txt.start = ib;
+            Txt.start = 6 * k;
 
             // reposition the text based on position
             float PtoTdx = Txt.position.x;
@@ -131,63 +216,65 @@ struct TextMaker
 
             for (int i = 0; i < Txt.usedLines; i++)
             {
-                for (int j = 0; j < Txt.l[i].length(); j++)
+                for (int j = 0; j < Txt.l[i].length() && k < maxGlyphs; j++)
                 {
                     int c = ((int)Txt.l[i][j]) - minChar;
                     if ((c >= 0) && (c <= maxChar))
                     {
-                        CharData d = Fonts[FontId].P[c];
-
-                        int mainStride = VD.Bindings[0].stride;
-                        std::vector<unsigned char> vertex(mainStride, 0);
-                        TextVertex *V_vertex = (TextVertex *)(&vertex[0]);
+                        CharData d = Fonts[fontId].P[c];
 
                         // Top-left vertex
-                        V_vertex->pos = {
+                        V[4 * k + 0].pos = {
                             (float)(tpx + d.xoffset) * PtoTsx + PtoTdx,
                             (float)(tpy + d.yoffset) * PtoTsy + PtoTdy};
-                        V_vertex->texCoord = {(float)d.x / texW, (float)d.y / texH};
-                        M.vertices.insert(M.vertices.end(), vertex.begin(), vertex.end());
+                        V[4 * k + 0].texCoord = {(float)d.x / texW, (float)d.y / texH};
 
                         // Top-right vertex
-                        V_vertex->pos = {
+                        V[4 * k + 1].pos = {
                             (float)(tpx + d.xoffset + d.width) * PtoTsx + PtoTdx,
                             (float)(tpy + d.yoffset) * PtoTsy + PtoTdy};
-                        V_vertex->texCoord = {(float)(d.x + d.width) / texW, (float)d.y / texH};
-                        M.vertices.insert(M.vertices.end(), vertex.begin(), vertex.end());
+                        V[4 * k + 1].texCoord = {(float)(d.x + d.width) / texW, (float)d.y / texH};
 
                         // Bottom-left vertex
-                        V_vertex->pos = {
+                        V[4 * k + 2].pos = {
                             (float)(tpx + d.xoffset) * PtoTsx + PtoTdx,
                             (float)(tpy + d.yoffset + d.height) * PtoTsy + PtoTdy};
-                        V_vertex->texCoord = {(float)d.x / texW, (float)(d.y + d.height) / texH};
-                        M.vertices.insert(M.vertices.end(), vertex.begin(), vertex.end());
+                        V[4 * k + 2].texCoord = {(float)d.x / texW, (float)(d.y + d.height) / texH};
 
                         // Bottom-right vertex
-                        V_vertex->pos = {
+                        V[4 * k + 3].pos = {
                             (float)(tpx + d.xoffset + d.width) * PtoTsx + PtoTdx,
                             (float)(tpy + d.yoffset + d.height) * PtoTsy + PtoTdy};
-                        V_vertex->texCoord = {(float)(d.x + d.width) / texW, (float)(d.y + d.height) / texH};
-                        M.vertices.insert(M.vertices.end(), vertex.begin(), vertex.end());
-
-                        // Indices for two triangles
-                        M.indices[ib + 0] = 4 * k + 0;
-                        M.indices[ib + 1] = 4 * k + 1;
-                        M.indices[ib + 2] = 4 * k + 2;
-                        M.indices[ib + 3] = 4 * k + 1;
-                        M.indices[ib + 4] = 4 * k + 2;
-                        M.indices[ib + 5] = 4 * k + 3;
-
-                        ib += 6;
+                        V[4 * k + 3].texCoord = {(float)(d.x + d.width) / texW, (float)(d.y + d.height) / texH};
+
                         tpx += d.xadvance;
                         k++;
                     }
                 }
-                tpy += Fonts[FontId].lineHeight;
+                tpy += Fonts[fontId].lineHeight;
                 tpx = 0;
             }
-            Txt.len = ib - Txt.start;
+            Txt.len = 6 * k - Txt.start;
+        }
+
+        BP->memoryAllocator.flush(vertexBufferMemory, sizeof(TextVertex) * 4 * maxGlyphs * region,
+                                  sizeof(TextVertex) * 4 * k);
+        return (uint32_t)k;
+    }
+
+    // called every frame, before the UI command buffer of currentImage is submitted
+    void update(int currentImage)
+    {
+        if (regionVersions[currentImage] != version)
+        {
+            regionGlyphs[currentImage] = writeTextQuads(currentImage);
+            VkDrawIndexedIndirectCommand *commands = (VkDrawIndexedIndirectCommand *)indirectBufferMemory.mapped;
+            commands[currentImage].indexCount = 6 * regionGlyphs[currentImage];
+            BP->memoryAllocator.flush(indirectBufferMemory, sizeof(VkDrawIndexedIndirectCommand) * currentImage,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+            regionVersions[currentImage] = version;
         }
+        BP->renderStats.addTriangles(2 * regionGlyphs[currentImage]);
     }
 
     void createTextDescriptorSets()
@@ -199,6 +286,11 @@ struct TextMaker
     {
         P.create();
         createTextDescriptorSets();
+        if (BP->swapChainImages.size() != regionCount)
+        {
+            destroyTextBuffers();
+            createTextBuffers((uint32_t)BP->swapChainImages.size());
+        }
     }
 
     void pipelinesAndDescriptorSetsCleanup()
@@ -210,7 +302,7 @@ struct TextMaker
     void localCleanup()
     {
         T.cleanup();
-        M.cleanup();
+        destroyTextBuffers();
         DSL.cleanup();
 
         P.destroy();
@@ -219,11 +311,20 @@ struct TextMaker
     void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage)
     {
         P.bind(commandBuffer);
-        M.bind(commandBuffer);
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
         DS.bind(commandBuffer, P, 0, currentImage);
 
-        vkCmdDrawIndexed(commandBuffer,
-                         static_cast<uint32_t>((*Texts)[0].len), 1, static_cast<uint32_t>((*Texts)[0].start), 0, 0);
+        vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, sizeof(VkDrawIndexedIndirectCommand) * currentImage, 1,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+
+        RenderStateStats recorded;
+        recorded.pipelineBinds = 1;
+        recorded.descriptorSetBinds = 1;
+        recorded.vertexBufferBinds = 1;
+        recorded.drawCalls = 1;
+        BP->renderStats.addRecorded(recorded);
     }
 };
 
@@ -0,0 +1,351 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// stb_image must already be included (see Starter.hpp): including it again here would duplicate
+// its implementation
+#include "MeshCache.hpp"
+
+/*
+ Baked texture cache.
+ The first launch decodes each image once, builds its whole mip chain on the CPU and stores it under
+ cache/textures; later launches read the levels back and upload them with plain buffer-to-image copies,
+ without decoding PNG/JPG files or blitting mips on the GPU. The file layout is:
+
+    TextureCacheHeader | TextureMipLevel[mipLevels] | level 0 texels | level 1 texels | ...
+
+ Texels are tightly packed rows of `channels` bytes, every level starts at a 16-byte aligned offset.
+ Sources keep their own channel count (1 = gray, 2 = gray + alpha, 4 = rgba); only 3-channel sources are
+ widened to 4, since 24-bit formats are rarely sampleable. Entries are not block-compressed.
+ A cached entry is used only if its dimensions, channels and level table are the ones its image would be
+ baked with and its texels fit in the file; otherwise the source is decoded again, as for a stale entry.
+ */
+
+const uint32_t TEXTURE_CACHE_MAGIC = 0x5854474D; // "MGTX"
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+const std::string TEXTURE_CACHE_DIRECTORY = "cache/textures";
+
+struct TextureCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t mipLevels;
+    uint32_t srgb;
+    uint32_t reserved;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+};
+
+static_assert(sizeof(TextureCacheHeader) % 16 == 0, "TextureCacheHeader must keep the sections 16-byte aligned");
+
+struct TextureMipLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// A decoded image with its full mip chain, ready to be copied into a VkImage
+struct BakedTexture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+    bool srgb = true;
+    std::vector<TextureMipLevel> mips;
+    std::vector<unsigned char> data;
+
+    uint32_t mipLevels() const { return (uint32_t)mips.size(); }
+    bool empty() const { return data.empty(); }
+
+    void release() {
+        mips.clear();
+        data.clear();
+        data.shrink_to_fit();
+    }
+};
+
+struct TextureCacheKey {
+    bool valid = false;
+    std::string cachePath;
+    bool srgb = true;
+    uint64_t sourceSize = 0;
+    uint64_t sourceHash = 0;
+};
+
+class TextureCache {
+
+    static uint64_t alignTo16(uint64_t value) {
+        return (value + 15) & ~uint64_t(15);
+    }
+
+    static float srgbToLinear(float c) {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static unsigned char linearToSrgb(float c) {
+        c = std::min(std::max(c, 0.0f), 1.0f);
+        float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return (unsigned char)std::lround(s * 255.0f);
+    }
+
+    // The level table of a width x height image; size is set to the bytes of all the levels
+    static std::vector<TextureMipLevel> mipLayout(uint32_t width, uint32_t height, uint32_t channels, uint64_t& size) {
+        uint32_t levels = (uint32_t)std::floor(std::log2(std::max(width, height))) + 1;
+        std::vector<TextureMipLevel> mips(levels);
+
+        uint64_t offset = 0;
+        uint32_t w = width, h = height;
+        for (uint32_t l = 0; l < levels; l++) {
+            mips[l] = {w, h, offset, (uint64_t)w * h * channels};
+            offset = alignTo16(offset + mips[l].size);
+            w = std::max(1u, w / 2);
+            h = std::max(1u, h / 2);
+        }
+        size = offset;
+        return mips;
+    }
+
+    // Lays out the level table for a width x height image and sizes the data buffer accordingly
+    static void layoutMips(BakedTexture& texture) {
+        uint64_t size = 0;
+        texture.mips = mipLayout(texture.width, texture.height, texture.channels, size);
+        texture.data.resize(size);
+    }
+
+    // 2x2 box filter, averaged in linear space for the color channels of sRGB images
+    static void buildMipChain(BakedTexture& texture) {
+        const uint32_t channels = texture.channels;
+        const uint32_t colorChannels = (channels == 2 || channels == 4) ? channels - 1 : channels;
+
+        float toLinear[256];
+        for (int i = 0; i < 256; i++) {
+            toLinear[i] = texture.srgb ? srgbToLinear(i / 255.0f) : i / 255.0f;
+        }
+
+        for (uint32_t l = 1; l < texture.mipLevels(); l++) {
+            const TextureMipLevel& src = texture.mips[l - 1];
+            const TextureMipLevel& dst = texture.mips[l];
+            const unsigned char* in = &texture.data[src.offset];
+            unsigned char* out = &texture.data[dst.offset];
+
+            for (uint32_t y = 0; y < dst.height; y++) {
+                uint32_t y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+                for (uint32_t x = 0; x < dst.width; x++) {
+                    uint32_t x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                    const unsigned char* p[4] = {
+                        in + ((size_t)y0 * src.width + x0) * channels, in + ((size_t)y0 * src.width + x1) * channels,
+                        in + ((size_t)y1 * src.width + x0) * channels, in + ((size_t)y1 * src.width + x1) * channels
+                    };
+                    unsigned char* o = out + ((size_t)y * dst.width + x) * channels;
+                    for (uint32_t c = 0; c < channels; c++) {
+                        if (c < colorChannels) {
+                            float sum = toLinear[p[0][c]] + toLinear[p[1][c]] + toLinear[p[2][c]] + toLinear[p[3][c]];
+                            o[c] = texture.srgb ? linearToSrgb(sum * 0.25f) : (unsigned char)std::lround(sum * 0.25f * 255.0f);
+                        } else {
+                            o[c] = (unsigned char)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+public:
+
+    static std::string pathFor(const std::string& sourceFile, bool srgb) {
+        std::string name = sourceFile;
+        for (char& c : name) {
+            if (c == '/' || c == '\\' || c == ':') c = '_';
+        }
+        return TEXTURE_CACHE_DIRECTORY + "/" + name + (srgb ? ".srgb" : ".unorm") + ".tex";
+    }
+
+    static TextureCacheKey makeKey(const std::string& sourceFile, bool srgb) {
+        TextureCacheKey key;
+        key.cachePath = pathFor(sourceFile, srgb);
+        key.srgb = srgb;
+
+        std::ifstream file(sourceFile, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            return key;
+        }
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> buffer(fileSize);
+        file.seekg(0);
+        file.read(buffer.data(), fileSize);
+
+        key.sourceSize = fileSize;
+        key.sourceHash = MeshCache::hash(buffer.data(), buffer.size());
+        key.valid = true;
+        return key;
+    }
+
+    // Decodes the source image and builds its mip chain; throws if the image cannot be decoded
+    static BakedTexture bake(const std::string& sourceFile, bool srgb) {
+        int width = 0, height = 0, channels = 0;
+        stbi_uc* pixels = stbi_load(sourceFile.c_str(), &width, &height, &channels, 0);
+        if (!pixels) {
+            throw std::runtime_error("failed to load texture image " + sourceFile + "!");
+        }
+
+        BakedTexture texture;
+        texture.width = (uint32_t)width;
+        texture.height = (uint32_t)height;
+        texture.channels = channels == 3 ? 4 : (uint32_t)channels;
+        texture.srgb = srgb;
+        layoutMips(texture);
+
+        const size_t texels = (size_t)width * height;
+        if (channels == 3) {
+            for (size_t i = 0; i < texels; i++) {
+                texture.data[4 * i + 0] = pixels[3 * i + 0];
+                texture.data[4 * i + 1] = pixels[3 * i + 1];
+                texture.data[4 * i + 2] = pixels[3 * i + 2];
+                texture.data[4 * i + 3] = 255;
+            }
+        } else {
+            memcpy(texture.data.data(), pixels, texels * channels);
+        }
+        stbi_image_free(pixels);
+
+        buildMipChain(texture);
+        return texture;
+    }
+
+    // Converts 1 and 2 channel textures to rgba, for devices that cannot sample R8 / R8G8
+    static void expandToRGBA(BakedTexture& texture) {
+        if (texture.channels == 4) return;
+
+        BakedTexture expanded;
+        expanded.width = texture.width;
+        expanded.height = texture.height;
+        expanded.channels = 4;
+        expanded.srgb = texture.srgb;
+        layoutMips(expanded);
+
+        for (uint32_t l = 0; l < texture.mipLevels(); l++) {
+            const unsigned char* in = &texture.data[texture.mips[l].offset];
+            unsigned char* out = &expanded.data[expanded.mips[l].offset];
+            size_t texels = (size_t)texture.mips[l].width * texture.mips[l].height;
+            for (size_t i = 0; i < texels; i++) {
+                unsigned char gray = in[i * texture.channels];
+                out[4 * i + 0] = gray;
+                out[4 * i + 1] = gray;
+                out[4 * i + 2] = gray;
+                out[4 * i + 3] = texture.channels == 2 ? in[i * 2 + 1] : 255;
+            }
+        }
+        texture = std::move(expanded);
+    }
+
+    static bool load(const TextureCacheKey& key, BakedTexture& texture) {
+        if (!key.valid) return false;
+
+        std::ifstream file(key.cachePath, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        TextureCacheHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+        if (header.magic != TEXTURE_CACHE_MAGIC ||
+            header.version != TEXTURE_CACHE_VERSION ||
+            header.srgb != (key.srgb ? 1u : 0u) ||
+            header.sourceSize != key.sourceSize ||
+            header.sourceHash != key.sourceHash) {
+            return false;
+        }
+
+        // the header must describe what bake would produce, and the texels must fit in the file,
+        // before anything is allocated from it
+        if (header.width == 0 || header.height == 0 ||
+            (header.channels != 1 && header.channels != 2 && header.channels != 4)) {
+            return false;
+        }
+        uint64_t dataSize = 0;
+        std::vector<TextureMipLevel> expected = mipLayout(header.width, header.height, header.channels, dataSize);
+        uint64_t dataOffset = alignTo16(sizeof(header) + expected.size() * sizeof(TextureMipLevel));
+        std::error_code ec;
+        uint64_t fileSize = std::filesystem::file_size(key.cachePath, ec);
+        if (ec || header.mipLevels != expected.size() || dataOffset > fileSize || dataSize > fileSize - dataOffset) {
+            return false;
+        }
+
+        BakedTexture cached;
+        cached.width = header.width;
+        cached.height = header.height;
+        cached.channels = header.channels;
+        cached.srgb = key.srgb;
+        cached.mips.resize(header.mipLevels);
+        if (!file.read(reinterpret_cast<char*>(cached.mips.data()), cached.mips.size() * sizeof(TextureMipLevel))) return false;
+        for (size_t l = 0; l < expected.size(); l++) {
+            if (cached.mips[l].width != expected[l].width || cached.mips[l].height != expected[l].height ||
+                cached.mips[l].offset != expected[l].offset || cached.mips[l].size != expected[l].size) {
+                return false;
+            }
+        }
+
+        cached.data.resize(dataSize);
+        file.seekg(dataOffset);
+        if (!file.read(reinterpret_cast<char*>(cached.data.data()), dataSize)) return false;
+
+        texture = std::move(cached);
+        return true;
+    }
+
+    static bool store(const TextureCacheKey& key, const BakedTexture& texture) {
+        if (!key.valid) return false;
+
+        std::error_code ec;
+        std::filesystem::create_directories(TEXTURE_CACHE_DIRECTORY, ec);
+        if (ec) {
+            std::cerr << "Texture cache: cannot create " << TEXTURE_CACHE_DIRECTORY << ": " << ec.message() << std::endl;
+            return false;
+        }
+
+        TextureCacheHeader header{};
+        header.magic = TEXTURE_CACHE_MAGIC;
+        header.version = TEXTURE_CACHE_VERSION;
+        header.width = texture.width;
+        header.height = texture.height;
+        header.channels = texture.channels;
+        header.mipLevels = texture.mipLevels();
+        header.srgb = key.srgb ? 1 : 0;
+        header.sourceSize = key.sourceSize;
+        header.sourceHash = key.sourceHash;
+
+        uint64_t tableEnd = sizeof(header) + texture.mips.size() * sizeof(TextureMipLevel);
+
+        const std::string tmpPath = key.cachePath + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+
+            const char zeros[16] = {};
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(texture.mips.data()), texture.mips.size() * sizeof(TextureMipLevel));
+            file.write(zeros, alignTo16(tableEnd) - tableEnd);
+            file.write(reinterpret_cast<const char*>(texture.data.data()), texture.data.size());
+            if (!file) return false;
+        }
+
+        std::filesystem::rename(tmpPath, key.cachePath, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
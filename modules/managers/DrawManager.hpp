@@ -18,24 +18,70 @@ protected:
     
     GlobalUniformBufferObject gubo{};
     
+    // objects that move (see GameObject::isStatic): the only ones updated every frame
+    std::vector<GameObject*> dynamicObjects;
+    // the visible objects of the group being drawn, reused across groups and frames
+    std::vector<GameObject*> visible;
+    
+    // draw list counters of the last frame, also reported through RenderStats (F3 overlay)
+    DrawListStats drawList;
+    
     void drawGameObjects() {
-        for(GameObject* obj : gameObjects){
+        for(GameObject* obj : dynamicObjects){
             obj->update();
-            switch (obj->getPipelineType()){
-                case PHONG:
-                    updatePhongUBO(obj->worldMatrix, cameraWorldData.viewProjection);
-                    obj->mapMemoryPhong(EngineCurrentImage, &gubo, &phongUbo);
-                    break;
-                case COOK_TORRANCE:
-                    updateCookTorranceUBO(obj->worldMatrix, cameraWorldData.viewProjection, obj->getProperty("metalness"), obj->getProperty("roughness"));
-                    obj->mapMemoryCookTorrance(EngineCurrentImage, &gubo, &cookTorranceUbo);
-                    break;
-                case TOON:
-                    updateToonUBO(obj->worldMatrix, cameraWorldData.viewProjection);
-                    obj->mapMemoryToon(EngineCurrentImage, &gubo, &toonUbo);
-                    break;
+        }
+        
+        Frustum frustum = Frustum::fromViewProjection(cameraWorldData.viewProjection);
+        drawList = {};
+        
+        // per-frame draw list: enabled and visible objects are packed at the front of their group's
+        // storage buffer, and the group's indirect command draws exactly that many instances; the
+        // instances only hold the model and normal matrices, so a group whose visible objects did not
+        // move since its buffers for this image were written is not uploaded again
+        for(InstanceGroup* group : instanceGroups){
+            visible.clear();
+            for(GameObject* obj : group->getObjects()){
+                if(!obj->isEnabled()){
+                    drawList.disabledObjects++;
+                    continue;
+                }
+                if(!group->isVisible(obj, frustum)){
+                    drawList.culledObjects++;
+                    continue;
+                }
+                visible.push_back(obj);
+            }
+            drawList.drawnObjects += (int)visible.size();
+            group->countTriangles((uint32_t)visible.size());
+            if(group->isUploaded(EngineCurrentImage, visible)){
+                continue;
             }
+            
+            for(size_t i = 0; i < visible.size(); i++){
+                GameObject* obj = visible[i];
+                switch (group->getPipelineType()){
+                    case PHONG:
+                        updatePhongUBO(obj);
+                        group->setInstance(i, phongUbo);
+                        break;
+                    case COOK_TORRANCE:
+                        updateCookTorranceUBO(obj, obj->getProperty("metalness"), obj->getProperty("roughness"));
+                        group->setInstance(i, cookTorranceUbo);
+                        break;
+                    case TOON:
+                        updateToonUBO(obj);
+                        group->setInstance(i, toonUbo);
+                        break;
+                }
+            }
+            drawList.uploadedObjects += (int)visible.size();
+            group->mapMemory(EngineCurrentImage, visible);
         }
+        
+        // the global uniforms are shared by all the draws: written once per frame
+        globalDescriptorSet.map(EngineCurrentImage, &gubo, sizeof(gubo), 0);
+        
+        EngineBaseProject->getRenderStats().setDrawList(drawList);
     }
     
     void initGUBO(){
@@ -56,32 +102,37 @@ protected:
             gubo.lightOn[i].v = lightsData.lightOn[i];
         }
         gubo.eyePos = cameraWorldData.position;
+        gubo.viewProjection = cameraWorldData.viewProjection;
     }
     
-    void updatePhongUBO(glm::mat4 worldMatrix, glm::mat4 viewProjection){
-        phongUbo.mMat = worldMatrix;
-        phongUbo.mvpMat = viewProjection * phongUbo.mMat;
-        phongUbo.nMat = glm::inverse(glm::transpose(phongUbo.mMat));
+    // the model and normal matrices are cached by the object until its transform changes
+    void updatePhongUBO(GameObject* obj){
+        phongUbo.mMat = obj->getWorldMatrix();
+        phongUbo.nMat = obj->getNormalMatrix();
     }
     
-    void updateCookTorranceUBO(glm::mat4 worldMatrix, glm::mat4 viewProjection, float metalness, float roughness){
-        cookTorranceUbo.mMat = worldMatrix;
-        cookTorranceUbo.mvpMat = viewProjection * cookTorranceUbo.mMat;
-        cookTorranceUbo.nMat = glm::inverse(glm::transpose(cookTorranceUbo.mMat));
+    void updateCookTorranceUBO(GameObject* obj, float metalness, float roughness){
+        cookTorranceUbo.mMat = obj->getWorldMatrix();
+        cookTorranceUbo.nMat = obj->getNormalMatrix();
         cookTorranceUbo.metalness = metalness;
         cookTorranceUbo.roughness = roughness;
     }
     
-    void updateToonUBO(glm::mat4 worldMatrix, glm::mat4 viewProjection){
-        toonUbo.mMat = worldMatrix;
-        toonUbo.mvpMat = viewProjection * toonUbo.mMat;
-        toonUbo.nMat = glm::inverse(glm::transpose(toonUbo.mMat));
+    void updateToonUBO(GameObject* obj){
+        toonUbo.mMat = obj->getWorldMatrix();
+        toonUbo.nMat = obj->getNormalMatrix();
     }
     
 public:
     
     void init() override {
         initGUBO();
+        dynamicObjects.clear();
+        for(GameObject* obj : gameObjects){
+            if(!obj->isStatic()){
+                dynamicObjects.push_back(obj);
+            }
+        }
     }
     
     void update() override {
@@ -89,6 +140,8 @@ public:
         drawGameObjects();
     }
     
+    const DrawListStats& getDrawListStats() const { return drawList; }
+    
     void cleanup() override {}
     
 };
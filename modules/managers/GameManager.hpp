@@ -1,8 +1,6 @@
 #ifndef GAME_MANAGER_HPP
 #define GAME_MANAGER_HPP
 
-#include <chrono>                       // for time tracking
-
 class GameManager : public Manager, public Receiver {
     
 protected:
@@ -13,11 +11,13 @@ protected:
     
     int collectedCoins = 0;
     
-    std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
-    std::chrono::time_point<std::chrono::high_resolution_clock> lastUpdateTime;
+    // game clock in seconds, advanced by EngineDeltaTime rather than read from the wall clock, so that
+    // a replayed race with a fixed timestep counts down and times the laps exactly as the first time
+    double gameTime = 0.0;
+    double lastUpdateTime = 0.0;
     
-    std::chrono::time_point<std::chrono::high_resolution_clock> startTimeAfterBegin;
-    std::chrono::time_point<std::chrono::high_resolution_clock> lastUpdateTimeAfterBegin;
+    double startTimeAfterBegin = 0.0;
+    double lastUpdateTimeAfterBegin = 0.0;
     
     // start-timer handle function
     void handleStartTimer(){
@@ -25,18 +25,15 @@ protected:
         if (countdownValue <= 0) {
             return; // Stop updating when countdown reaches zero
         }
-        auto now = std::chrono::high_resolution_clock::now();
-        auto durationSinceLastUpdate = std::chrono::duration_cast<std::chrono::seconds>(now - lastUpdateTime);
-
-        if (durationSinceLastUpdate.count() >= 1) {
+        if (gameTime - lastUpdateTime >= 1.0) {
             countdownSignal.emit(countdownValue);
             countdownValue--;
-            lastUpdateTime = now; // Update the last update time
+            lastUpdateTime = gameTime; // Update the last update time
             
             // Start real game timer
             if(countdownValue <= 0){
                 isGameStarted = true;
-                startTimeAfterBegin = std::chrono::high_resolution_clock::now();
+                startTimeAfterBegin = gameTime;
                 lastUpdateTimeAfterBegin = startTimeAfterBegin;
             }
         }
@@ -44,29 +41,25 @@ protected:
     
     // timer handle function
     void handleTimer(){
-        auto now = std::chrono::high_resolution_clock::now();
-        auto durationSinceLastUpdate = std::chrono::duration_cast<std::chrono::seconds>(now - lastUpdateTimeAfterBegin);
-        
-        if (durationSinceLastUpdate.count() >= 1) {
-            auto durationSinceStart = std::chrono::duration_cast<std::chrono::seconds>(now - startTimeAfterBegin);
-            int totalSeconds = static_cast<int>(durationSinceStart.count());
+        if (gameTime - lastUpdateTimeAfterBegin >= 1.0) {
+            int totalSeconds = static_cast<int>(gameTime - startTimeAfterBegin);
             int minutes = totalSeconds / 60;
             int seconds = totalSeconds % 60;
             std::string timeString = (minutes < 10 ? "0" : "") + std::to_string(minutes) + ":" + (seconds < 10 ? "0" : "") + std::to_string(seconds);
             timeSignal.emit(timeString);
-            lastUpdateTimeAfterBegin = now; // Update the last update time
+            lastUpdateTimeAfterBegin = gameTime; // Update the last update time
         }
     }
     
-    int computeFinalScore(std::chrono::seconds endTime){
-        int remainingTime = 500 - static_cast<int>(endTime.count());
+    int computeFinalScore(int endTime){
+        int remainingTime = 500 - endTime;
         return std::max(remainingTime, 0) + collectedCoins;
     }
     
     void onLapChanged(int currentLap) {
         // after the second lap stop the timer
         if(currentLap == 0 && !isGameFinished) {
-            auto endTime = std::chrono::duration_cast<std::chrono::seconds>(lastUpdateTimeAfterBegin - startTimeAfterBegin);
+            int endTime = static_cast<int>(lastUpdateTimeAfterBegin - startTimeAfterBegin);
             
             isGameFinished = true;
             int finalScore = computeFinalScore(endTime);
@@ -84,11 +77,12 @@ protected:
 public:
     
     void init() override {
-        startTime = std::chrono::high_resolution_clock::now();
-        lastUpdateTime = startTime;
+        gameTime = 0.0;
+        lastUpdateTime = gameTime;
     }
     
     void update() override {
+        gameTime += EngineDeltaTime;
         if(!isGameStarted) handleStartTimer();  // if start-timer changes update the UI
         else if(!isGameFinished) handleTimer(); // if real timer changes update UI
     }
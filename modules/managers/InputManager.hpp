@@ -11,16 +11,19 @@ class InputManager : public Manager {
     
 protected:
     
+    bool dumpProfileKeyDown = false;
+    bool statsOverlayKeyDown = false;
+    
     void checkShouldQuit() {
-        if (glfwGetKey(EngineWindow, GLFW_KEY_ESCAPE)) {
+        if (EngineBaseProject->isKeyPressed(GLFW_KEY_ESCAPE)) {
             quitSignal.emit({});
         }
     }
     
     void checkShouldChangeCamera() {
-        if (glfwGetKey(EngineWindow, GLFW_KEY_SPACE)) {
+        if (EngineBaseProject->isKeyPressed(GLFW_KEY_SPACE)) {
+            // only the view-projection changes, which is per-frame uniform data: nothing to rebuild
             changeCameraSignal.emit({});
-            rebuildPipelineSignal.emit({});
         }
         else{
             updateDebounceSignal.emit({});
@@ -28,13 +31,31 @@ protected:
     }
     
     void checkShouldChangeHeadlightsStatus() {
-        if ((glfwGetKey(EngineWindow, GLFW_KEY_L))) {
+        if ((EngineBaseProject->isKeyPressed(GLFW_KEY_L))) {
             headlightsChangeSignal.emit({});
         }
     }
     
+    // writes the profiler trace once per press of P
+    void checkDumpProfile() {
+        bool pressed = EngineBaseProject->isKeyPressed(GLFW_KEY_P);
+        if (pressed && !dumpProfileKeyDown) {
+            EngineBaseProject->dumpProfile();
+        }
+        dumpProfileKeyDown = pressed;
+    }
+    
+    // shows or hides the performance overlay once per press of F3
+    void checkToggleStatsOverlay() {
+        bool pressed = EngineBaseProject->isKeyPressed(GLFW_KEY_F3);
+        if (pressed && !statsOverlayKeyDown) {
+            statsOverlaySignal.emit({});
+        }
+        statsOverlayKeyDown = pressed;
+    }
+    
     void checkResetView() {
-        if (glfwGetKey(EngineWindow, GLFW_KEY_V)) {
+        if (EngineBaseProject->isKeyPressed(GLFW_KEY_V)) {
             resetViewSignal.emit({});
         }
     }
@@ -48,6 +69,8 @@ public:
         checkShouldChangeCamera();
         checkShouldChangeHeadlightsStatus();
         checkResetView();
+        checkDumpProfile();
+        checkToggleStatsOverlay();
     }
     
     void cleanup() override {}
@@ -250,10 +250,10 @@ public:
         updateLightWorldMatrix(_rightBrakeLightIndex, vehicleTextureWorldMatrix);
         updateLightWorldMatrix(_leftHeadlightIndex, vehicleTextureWorldMatrix);
         updateLightWorldMatrix(_rightHeadlightIndex, vehicleTextureWorldMatrix);
-        updateLightWorldMatrix(_airplaneHeadlightIndex, gameObjects[_airplaneObjectIndex]->worldMatrix);
-        updateLightWorldMatrix(_spaceship1HeadlightIndex, gameObjects[_spaceship1ObjectIndex]->worldMatrix);
-        updateLightWorldMatrix(_spaceship2HeadlightIndex, gameObjects[_spaceship2ObjectIndex]->worldMatrix);
-        updateLightWorldMatrix(_spaceship3HeadlightIndex, gameObjects[_spaceship3ObjectIndex]->worldMatrix);
+        updateLightWorldMatrix(_airplaneHeadlightIndex, gameObjects[_airplaneObjectIndex]->getWorldMatrix());
+        updateLightWorldMatrix(_spaceship1HeadlightIndex, gameObjects[_spaceship1ObjectIndex]->getWorldMatrix());
+        updateLightWorldMatrix(_spaceship2HeadlightIndex, gameObjects[_spaceship2ObjectIndex]->getWorldMatrix());
+        updateLightWorldMatrix(_spaceship3HeadlightIndex, gameObjects[_spaceship3ObjectIndex]->getWorldMatrix());
         
         if(waitHeadlights < 60){
             waitHeadlights++;
@@ -73,7 +73,10 @@ public:
     }
     
     void update() override {
-        dynamicsWorld->stepSimulation(EngineDeltaTime, 60);
+        {
+            PROFILE_SCOPE("stepSimulation");
+            dynamicsWorld->stepSimulation(EngineDeltaTime, 60);
+        }
         checkCollisions(vehicle);
         processRigidBodyQueues();
     }
@@ -95,6 +98,7 @@ public:
                 delete rigidBodyObj->getCollisionShape();
             }
         }
+        RigidBody::cleanupSharedMeshShapes();
         
         delete dynamicsWorld;
         delete solver;
@@ -10,6 +10,7 @@ class SceneManager : public Manager, public Receiver {
 protected:
     
     void onQuit() {
+        if (EngineWindow == nullptr) return;
         glfwSetWindowShouldClose(EngineWindow, GL_TRUE);
     }
     
@@ -14,99 +14,147 @@ protected:
     glm::vec2 outSpeedPosition = glm::vec2(-0.06f, 0.815f);
     glm::vec2 outCoinsPosition = glm::vec2(0.56f, 0.815f);
     
-    // Text Vectors
-    std::vector<SingleText> outTimer = {
-        {1, {"Time: 00:00"}, 0, 0, outTimerPosition}
-    };
-    
-    std::vector<SingleText> outLaps = {
-        {1, {"Lap: 1/2"}, 0, 0, outLapsPosition}
-    };
-    
-    std::vector<SingleText> outSpeed = {
-        {1, {"Speed: 0 km/h"}, 0, 0, outSpeedPosition}
-    };
-    
-    std::vector<SingleText> outCoins = {
-        {1, {"Coins: 0"}, 0, 0, outCoinsPosition}
-    };
-    
-    // Text Makers
-    TextMaker laps;
-    TextMaker timer;
-    TextMaker speed;
-    TextMaker coins;
+    // Texts, all drawn by the same batcher
+    TextMaker hud;
+    int lapsText;
+    int timerText;
+    int speedText;
+    int coinsText;
+    
+    // formats into a stack buffer: the batcher keeps its own copy, so nothing is allocated per change
+    char textBuffer[TEXT_LINE_CAPACITY];
+    
+    // Performance overlay (F3), in the small font at the top left. It is drawn at the end of the scene pass,
+    // since the HUD render pass only covers the HUD strip; hidden, its texts are empty and it draws nothing.
+    static const int OVERLAY_LINES = 6;
+    const int overlayFont = 2;
+    const float overlayRefreshSeconds = 0.25f;
+    glm::vec2 overlayPosition = glm::vec2(-0.98f, -0.97f);
+    float overlayLineHeight = 0.06f;
+    TextMaker overlay;
+    int overlayTexts[OVERLAY_LINES];
+    bool overlayVisible = false;
+    float overlayAge = 0.0f;
+    
+    void refreshOverlay() {
+        overlayAge = 0.0f;
+        if (!overlayVisible) {
+            for (int line = 0; line < OVERLAY_LINES; line++) {
+                overlay.setText(overlayTexts[line], "");
+            }
+            return;
+        }
+        
+        const RenderStats& stats = EngineBaseProject->getRenderStats();
+        if (stats.historySize() == 0) return;
+        const RenderStatsFrame& frame = stats.getFrame(0);
+        
+        snprintf(textBuffer, sizeof(textBuffer), "FPS %.0f  frame p50 %.2f ms  p99 %.2f ms",
+                 stats.fps(60), stats.frameTimePercentile(0.5), stats.frameTimePercentile(0.99));
+        overlay.setText(overlayTexts[0], textBuffer);
+        if (frame.gpuMs > 0.0) {
+            snprintf(textBuffer, sizeof(textBuffer), "GPU %.2f ms", frame.gpuMs);
+        } else {
+            snprintf(textBuffer, sizeof(textBuffer), "GPU n/a");
+        }
+        overlay.setText(overlayTexts[1], textBuffer);
+        snprintf(textBuffer, sizeof(textBuffer), "Draws %d  Triangles %llu",
+                 frame.commands.drawCalls, (unsigned long long)frame.triangles);
+        overlay.setText(overlayTexts[2], textBuffer);
+        snprintf(textBuffer, sizeof(textBuffer), "Pipeline binds %d  Descriptor set binds %d",
+                 frame.commands.pipelineBinds, frame.commands.descriptorSetBinds);
+        overlay.setText(overlayTexts[3], textBuffer);
+        snprintf(textBuffer, sizeof(textBuffer), "Uniforms %.1f KB  Buffers +%u -%u",
+                 frame.uniformBytes / 1024.0, frame.buffersCreated, frame.buffersDestroyed);
+        overlay.setText(overlayTexts[4], textBuffer);
+        snprintf(textBuffer, sizeof(textBuffer), "Objects %d drawn (%d uploaded)  %d culled  %d disabled",
+                 frame.drawList.drawnObjects, frame.drawList.uploadedObjects,
+                 frame.drawList.culledObjects, frame.drawList.disabledObjects);
+        overlay.setText(overlayTexts[5], textBuffer);
+    }
     
     // timer handle function
     void onTimeChanged(std::string timeString){
-        outTimer[0] = {1, {"Time: " + timeString}, 0, 0, outTimerPosition};
-        timer.changeText(&outTimer);
+        snprintf(textBuffer, sizeof(textBuffer), "Time: %s", timeString.c_str());
+        hud.setText(timerText, textBuffer);
     }
     
     void onSpeedChanged(int currentSpeedKmh) {
-        outSpeed[0] = {1, {"Speed: " + std::to_string(currentSpeedKmh) + " km/h"}, 0, 0, outSpeedPosition};
-        speed.changeText(&outSpeed);
+        snprintf(textBuffer, sizeof(textBuffer), "Speed: %d km/h", currentSpeedKmh);
+        hud.setText(speedText, textBuffer);
     }
     
     void onCoinsChanged(int collectedCoins) {
-        outCoins[0] = {1, {"Coins: " + std::to_string(collectedCoins)}, 0, 0, outCoinsPosition};
-        coins.changeText(&outCoins);
+        snprintf(textBuffer, sizeof(textBuffer), "Coins: %d", collectedCoins);
+        hud.setText(coinsText, textBuffer);
     }
     
     void onLapChanged(int currentLap) {
         if (currentLap != 0){
-            outLaps[0] = {1, {"Lap: " + std::to_string(currentLap) + "/2"}, 0, 0, outLapsPosition};
-            laps.changeText(&outLaps);
+            snprintf(textBuffer, sizeof(textBuffer), "Lap: %d/2", currentLap);
+            hud.setText(lapsText, textBuffer);
         }
     }
     
     void onScoreGenerated(int score){
-        outLaps[0] = {1, {"Score: " + std::to_string(score)}, 0, 0, outLapsPosition};
-        laps.changeText(&outLaps);
+        snprintf(textBuffer, sizeof(textBuffer), "Score: %d", score);
+        hud.setText(lapsText, textBuffer);
     }
 
 
 public:
 
+    // descriptor sets of the UI: one per text maker (hud and overlay), each holding its font texture
+    static const int DESCRIPTOR_SETS = 2;
+
     void init() override {
-        // init TextMakers
-        laps.init(EngineBaseProject, &outLaps);
-        timer.init(EngineBaseProject, &outTimer);
-        speed.init(EngineBaseProject, &outSpeed);
-        coins.init(EngineBaseProject, &outCoins);
+        hud.init(EngineBaseProject);
+        lapsText = hud.addText("Lap: 1/2", outLapsPosition);
+        timerText = hud.addText("Time: 00:00", outTimerPosition);
+        speedText = hud.addText("Speed: 0 km/h", outSpeedPosition);
+        coinsText = hud.addText("Coins: 0", outCoinsPosition);
+        
+        overlay.init(EngineBaseProject, OVERLAY_LINES * (int)TEXT_LINE_CAPACITY, overlayFont);
+        for (int line = 0; line < OVERLAY_LINES; line++) {
+            overlayTexts[line] = overlay.addText("", overlayPosition + glm::vec2(0.0f, line * overlayLineHeight));
+        }
     }
     
     // lifecycle methods
     void pipelinesAndDescriptorSetsInit() {
-        laps.pipelinesAndDescriptorSetsInit();
-        timer.pipelinesAndDescriptorSetsInit();
-        speed.pipelinesAndDescriptorSetsInit();
-        coins.pipelinesAndDescriptorSetsInit();
-
+        hud.pipelinesAndDescriptorSetsInit();
+        overlay.pipelinesAndDescriptorSetsInit();
     }
     
     void pipelinesAndDescriptorSetsCleanup() {
-        laps.pipelinesAndDescriptorSetsCleanup();
-        timer.pipelinesAndDescriptorSetsCleanup();
-        speed.pipelinesAndDescriptorSetsCleanup();
-        coins.pipelinesAndDescriptorSetsCleanup();
-
+        hud.pipelinesAndDescriptorSetsCleanup();
+        overlay.pipelinesAndDescriptorSetsCleanup();
     }
     
     void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage) {
-        laps.populateCommandBuffer(commandBuffer, currentImage);
-        timer.populateCommandBuffer(commandBuffer, currentImage);
-        speed.populateCommandBuffer(commandBuffer, currentImage);
-        coins.populateCommandBuffer(commandBuffer, currentImage);
+        hud.populateCommandBuffer(commandBuffer, currentImage);
     }
     
-    void update() override {}
+    // recorded in the scene command buffer, after the scene
+    void populateOverlayCommandBuffer(VkCommandBuffer commandBuffer, int currentImage) {
+        overlay.populateCommandBuffer(commandBuffer, currentImage);
+    }
+    
+    // writes the changed texts into the vertex buffer region of the image being drawn
+    void update() override {
+        if (overlayVisible) {
+            overlayAge += EngineDeltaTime;
+            if (overlayAge >= overlayRefreshSeconds) {
+                refreshOverlay();
+            }
+        }
+        hud.update(EngineCurrentImage);
+        overlay.update(EngineCurrentImage);
+    }
     
     void cleanup() override {
-        laps.localCleanup();
-        timer.localCleanup();
-        speed.localCleanup();
-        coins.localCleanup();
+        hud.localCleanup();
+        overlay.localCleanup();
     }
     
     void onSignal(std::string id, std::any data) override {
@@ -120,6 +168,9 @@ public:
             onLapChanged(std::any_cast<int>(data));
         } else if (id == SCORE_SIGNAL) {
             onScoreGenerated(std::any_cast<int>(data));
+        } else if (id == STATS_OVERLAY_SIGNAL) {
+            overlayVisible = !overlayVisible;
+            refreshOverlay();
         }
         else {
             std::cerr << "Unknown signal type: " << id << std::endl;
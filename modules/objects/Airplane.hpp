@@ -17,17 +17,17 @@ class Airplane: public GameObject {
 
 public:
     
-    Airplane(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props)
-    : GameObject(id, m, t, wm, ds, pt, props) {}
+    Airplane(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props)
+    : GameObject(id, m, t, wm, pt, props) {}
     
     void update() override {
         // updates airplane's position
         switch(airplaneActionsDone){
                 
             case 0:
-                if(worldMatrix[3][2] > AIRPLANE_FIRST_TURN){
+                if(getWorldMatrix()[3][2] > AIRPLANE_FIRST_TURN){
                     if(airplaneAngle < 90.0f){
-                        worldMatrix = glm::rotate(worldMatrix, -DEG_2_5, Y_AXIS);
+                        setWorldMatrix(glm::rotate(getWorldMatrix(), -DEG_2_5, Y_AXIS));
                         airplaneAngle += 2.5;
                     }
                     if(airplaneAngle >= 90.0f){
@@ -37,9 +37,9 @@ public:
                 break;
                 
             case 1:
-                if(worldMatrix[3][0] < AIRPLANE_SECOND_TURN){
+                if(getWorldMatrix()[3][0] < AIRPLANE_SECOND_TURN){
                     if(airplaneAngle < 180.0f){
-                        worldMatrix = glm::rotate(worldMatrix, -DEG_2_5, Y_AXIS);
+                        setWorldMatrix(glm::rotate(getWorldMatrix(), -DEG_2_5, Y_AXIS));
                         airplaneAngle += 2.5;
                     }
                     if(airplaneAngle >= 180.0f){
@@ -49,11 +49,11 @@ public:
                 break;
             
             case 2:
-                if(worldMatrix[3][2] < AIRPLANE_LANDING){
-                    if(worldMatrix[3][1] > AIRPLANE_LAND_Y){
-                        worldMatrix = glm::translate(worldMatrix, glm::vec3(0.0f, -AIRPLANE_LAND_MOV_PER_FRAME, 0.0f));
+                if(getWorldMatrix()[3][2] < AIRPLANE_LANDING){
+                    if(getWorldMatrix()[3][1] > AIRPLANE_LAND_Y){
+                        setWorldMatrix(glm::translate(getWorldMatrix(), glm::vec3(0.0f, -AIRPLANE_LAND_MOV_PER_FRAME, 0.0f)));
                     }
-                    if(worldMatrix[3][1] <= AIRPLANE_LAND_Y){
+                    if(getWorldMatrix()[3][1] <= AIRPLANE_LAND_Y){
                         airplaneActionsDone++;
                     }
                 }
@@ -75,8 +75,8 @@ public:
         }
         
         if(airplaneActionsDone < 4){
-            worldMatrix = glm::translate(worldMatrix, glm::vec3(0.0f, 0.0f, AIRPLANE_MOV_PER_FRAME
-                                                                      * brakingFactor));
+            setWorldMatrix(glm::translate(getWorldMatrix(), glm::vec3(0.0f, 0.0f, AIRPLANE_MOV_PER_FRAME
+                                                                      * brakingFactor)));
         }
     }
     
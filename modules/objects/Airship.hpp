@@ -9,22 +9,22 @@ class Airship: public GameObject {
  
 public:
     
-    Airship(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props)
-    : GameObject(id, m, t, wm, ds, pt, props) {}
+    Airship(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props)
+    : GameObject(id, m, t, wm, pt, props) {}
     
     void update() override {
         // updates airship's transform matrix
         if(airshipGoingUp){
-            if(worldMatrix[3][1] < 3.0f){
-                worldMatrix = glm::translate(worldMatrix, glm::vec3(0.0f, AIRSHIP_MOV_PER_FRAME, 0.0f));
+            if(getWorldMatrix()[3][1] < 3.0f){
+                setWorldMatrix(glm::translate(getWorldMatrix(), glm::vec3(0.0f, AIRSHIP_MOV_PER_FRAME, 0.0f)));
             }
             else{
                 airshipGoingUp = false;
             }
         }
         else{
-            if(worldMatrix[3][1] > -3.0f){
-                worldMatrix = glm::translate(worldMatrix, glm::vec3(0.0f, -AIRSHIP_MOV_PER_FRAME, 0.0f));
+            if(getWorldMatrix()[3][1] > -3.0f){
+                setWorldMatrix(glm::translate(getWorldMatrix(), glm::vec3(0.0f, -AIRSHIP_MOV_PER_FRAME, 0.0f)));
             }
             else{
                 airshipGoingUp = true;
@@ -10,8 +10,8 @@ class Coin: public GameObject, public KinematicRigidBody, public Collider {
     
 public:
     
-    Coin(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props) :
-    GameObject(id, m, t, wm, ds, pt, props),
+    Coin(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props) :
+    GameObject(id, m, t, wm, pt, props),
     KinematicRigidBody(new btSphereShape(1.0f), wm),
     Collider() {}
     
@@ -22,7 +22,7 @@ public:
     void update() override {
         if (enabled) {
             // Coin is present in the world, update its transform matrix
-            worldMatrix = glm::rotate(worldMatrix, DEG_5, Z_AXIS);
+            setWorldMatrix(glm::rotate(getWorldMatrix(), DEG_5, Z_AXIS));
         }
     }
     
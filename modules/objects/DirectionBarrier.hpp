@@ -7,10 +7,12 @@ class DirectionBarrier: public GameObject, public StaticRigidBody {
   
 public:
     
-    DirectionBarrier(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props) :
-    GameObject(id, m, t, wm, ds, pt, props),
+    DirectionBarrier(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props) :
+    GameObject(id, m, t, wm, pt, props),
     StaticRigidBody(m, wm, 0.8f, 0.5f) {}
     
+    bool isStatic() const override { return true; }
+    
 };
 
 #endif
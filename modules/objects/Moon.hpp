@@ -5,11 +5,11 @@ class Moon: public GameObject {
     
 public:
     
-    Moon(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props)
-    : GameObject(id, m, t, wm, ds, pt, props) {}
+    Moon(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props)
+    : GameObject(id, m, t, wm, pt, props) {}
     
     void update() override {
-        worldMatrix = glm::rotate(worldMatrix, -DEG_0_2, Y_AXIS);
+        setWorldMatrix(glm::rotate(getWorldMatrix(), -DEG_0_2, Y_AXIS));
     }
     
 };
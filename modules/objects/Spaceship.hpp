@@ -9,15 +9,17 @@ class Spaceship: public GameObject {
    
 public:
     
-    Spaceship(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props)
-    : GameObject(id, m, t, wm, ds, pt, props) {}
+    Spaceship(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props)
+    : GameObject(id, m, t, wm, pt, props) {}
     
     void update() override {
-        if(worldMatrix[3][0] <= -SPACE_SHIP_MAX_DIST){
-            worldMatrix[3][0] = SPACE_SHIP_MAX_DIST;
+        if(getWorldMatrix()[3][0] <= -SPACE_SHIP_MAX_DIST){
+            glm::mat4 wm = getWorldMatrix();
+            wm[3][0] = SPACE_SHIP_MAX_DIST;
+            setWorldMatrix(wm);
         }
         else{
-            worldMatrix = glm::translate(worldMatrix, glm::vec3(SPACE_SHIP_MOV_PER_FRAME, 0.0f, 0.0f));
+            setWorldMatrix(glm::translate(getWorldMatrix(), glm::vec3(SPACE_SHIP_MOV_PER_FRAME, 0.0f, 0.0f)));
         }
     }
     
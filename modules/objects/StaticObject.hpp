@@ -7,8 +7,10 @@ class StaticObject: public GameObject {
     
 public:
     
-    StaticObject(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props)
-    : GameObject(id, m, t, wm, ds, pt, props) {}
+    StaticObject(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props)
+    : GameObject(id, m, t, wm, pt, props) {}
+    
+    bool isStatic() const override { return true; }
     
 };
 
@@ -103,8 +103,8 @@ protected:
 
 public:
     
-    Track(std::string id, Model* m, Texture* t, glm::mat4 wm, DescriptorSet* ds, PipelineType pt, std::unordered_map<std::string, float> props) :
-    GameObject(id, m, t, wm, ds, pt, props),
+    Track(std::string id, Model* m, Texture* t, glm::mat4 wm, PipelineType pt, std::unordered_map<std::string, float> props) :
+    GameObject(id, m, t, wm, pt, props),
     StaticRigidBody(m, wm, 0.0f, 0.0f) {
         currentLap = 1;
         this->checkpoints = {
@@ -121,6 +121,8 @@ public:
         setCheckpointsBasedOnLap(currentLap);
     }
     
+    bool isStatic() const override { return true; }
+    
     void init() override {
         setBarrierStatus("dir_barrier_inner", false);
         std::vector<Signal*> trackSignals = { &updateNextCheckpointSignal };
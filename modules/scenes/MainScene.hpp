@@ -16,8 +16,10 @@
 #include "../modules/objects/StaticObject.hpp"
 #include "../modules/objects/Track.hpp"
 #include "../modules/engine/main/GameObject.hpp"
+#include "../modules/engine/main/graphics/Material.hpp"
 #include "../managers/DrawManager.hpp"
 #include "Utils.hpp"
+#include <functional>
 #include <random>
 
 class MainScene: public Scene{
@@ -25,64 +27,75 @@ class MainScene: public Scene{
 protected:
     
     int coinCount = 0;
+    
+    // creates an object of the given id with its material
+    using ObjectFactory = std::function<GameObject*(const std::string& id, Model* model, Texture* texture,
+                                                    const glm::mat4& worldMatrix, const Material& material)>;
+    
+    struct ObjectKind {
+        std::string prefix;
+        ObjectFactory create;
+        Material material;
+    };
+    
+    template <typename T>
+    static ObjectFactory factory() {
+        return [](const std::string& id, Model* model, Texture* texture, const glm::mat4& worldMatrix, const Material& material) -> GameObject* {
+            return new T(id, model, texture, worldMatrix, material.pipelineType, material.properties);
+        };
+    }
+    
+    // fireworks start at a random frame (seeded with the recorded input seed in init)
+    std::mt19937 fireworkRandom;
+    std::uniform_int_distribution<> fireworkStartFrame{0, 40}; // Intervallo [0, 40]
+    
+    // class and material of the objects whose id starts with the given prefix (the first match wins);
+    // the render queue sorts the draws by the pipeline of the material
+    const std::vector<ObjectKind> OBJECT_KINDS = {
+        {"airplane",    factory<Airplane>(),         {TOON, {}}},
+        {"airship",     factory<Airship>(),          {TOON, {}}},
+        {"barrier",     factory<Barrier>(),          {PHONG, {}}},
+        {"car",         factory<Car>(),              {COOK_TORRANCE, {{"metalness", 0.85f}, {"roughness", 0.3f}}}},
+        {"coin",        factory<Coin>(),             {COOK_TORRANCE, {{"metalness", 1.0f}, {"roughness", 0.05f}}}},
+        {"dir_barrier", factory<DirectionBarrier>(), {PHONG, {}}},
+        {"earth",       factory<Earth>(),            {TOON, {}}},
+        {"firework",    [this](const std::string& id, Model* model, Texture* texture, const glm::mat4& worldMatrix, const Material& material) -> GameObject* {
+                            return new Firework(id, model, texture, worldMatrix, material.pipelineType, material.properties,
+                                                fireworkStartFrame(fireworkRandom));
+                        },                           {TOON, {}}},
+        {"moon",        factory<Moon>(),             {TOON, {}}},
+        {"tires_pile",  factory<Obstacle>(),         {TOON, {}}},
+        {"ramps",       factory<Ramps>(),            {TOON, {}}},
+        {"spaceship",   factory<Spaceship>(),        {TOON, {}}},
+        {"track",       factory<Track>(),            {PHONG, {}}}
+    };
+    const ObjectKind DEFAULT_KIND = {"", factory<StaticObject>(), {TOON, {}}};
+    
+    const ObjectKind& kindFor(const std::string& id) const {
+        for (const ObjectKind& kind : OBJECT_KINDS) {
+            if (id.starts_with(kind.prefix)) {
+                return kind;
+            }
+        }
+        return DEFAULT_KIND;
+    }
 
 public:
     
     void init() override {
         
-        // Crea un generatore di numeri casuali
-        std::random_device rd;  // Entropia hardware (se disponibile)
-        std::mt19937 gen(rd()); // Generatore di numeri casuali Mersenne Twister
-        std::uniform_int_distribution<> distrib(0, 40); // Intervallo [0, 40]
+        // Generatore di numeri casuali Mersenne Twister (seme registrato con l'input)
+        fireworkRandom.seed(EngineRandomSeed);
 
         for (json instance : Instances) {
             
-            GameObject* object = nullptr;
-            
             const std::string id = instance["id"];
             Model* model = Models[ModelIds[instance["model"]]];
             Texture* texture = Textures[TextureIds[instance["texture"]]];
             glm::mat4 worldMatrix = WorldMatrices[id];
-            DescriptorSet* descriptorSet = new DescriptorSet();
 
-            if (id.starts_with("airplane")) {
-                object = new Airplane(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            } else if (id.starts_with("airship")) {
-                object = new Airship(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            } else if (id.starts_with("barrier")) {
-                object = new Barrier(id, model, texture, worldMatrix, descriptorSet, PHONG, {});
-            } else if (id.starts_with("car")) {
-                object = new Car(id, model, texture, worldMatrix, descriptorSet, COOK_TORRANCE, {
-                    {"metalness", 0.85f},
-                    {"roughness", 0.3f}
-                });
-            } else if (id.starts_with("coin")) {
-                object = new Coin(id, model, texture, worldMatrix, descriptorSet, COOK_TORRANCE, {
-                    {"metalness", 1.0f},
-                    {"roughness", 0.05f}
-                });
-            } else if (id.starts_with("dir_barrier")) {
-                object = new DirectionBarrier(id, model, texture, worldMatrix, descriptorSet, PHONG, {});
-            } else if (id.starts_with("earth")) {
-                object = new Earth(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            } else if (id.starts_with("firework")) {
-                // Generate a random number
-                int randomNumber = distrib(gen);
-                // Generate a firework
-                object = new Firework(id, model, texture, worldMatrix, descriptorSet, TOON, {}, randomNumber);
-            } else if (id.starts_with("moon")) {
-                object = new Moon(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            } else if (id.starts_with("tires_pile")) {
-                object = new Obstacle(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            } else if (id.starts_with("ramps")) {
-                object = new Ramps(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            } else if (id.starts_with("spaceship")) {
-                object = new Spaceship(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            } else if (id.starts_with("track")) {
-                object = new Track(id, model, texture, worldMatrix, descriptorSet, PHONG, {});
-            } else {
-                object = new StaticObject(id, model, texture, worldMatrix, descriptorSet, TOON, {});
-            }
+            const ObjectKind& kind = kindFor(id);
+            GameObject* object = kind.create(id, model, texture, worldMatrix, kind.material);
 
             if (object) {
                 gameObjects.push_back(object);
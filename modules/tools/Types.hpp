@@ -30,13 +30,11 @@ struct CarWorldData {
 };
 
 struct PhongUniformBufferObject {
-    alignas(16) glm::mat4 mvpMat;
     alignas(16) glm::mat4 mMat;
     alignas(16) glm::mat4 nMat;
 };
 
 struct CookTorranceUniformBufferObject {
-    alignas(16) glm::mat4 mvpMat;
     alignas(16) glm::mat4 mMat;
     alignas(16) glm::mat4 nMat;
     alignas(4) float metalness;
@@ -44,7 +42,6 @@ struct CookTorranceUniformBufferObject {
 };
 
 struct ToonUniformBufferObject {
-    alignas(16) glm::mat4 mvpMat;
     alignas(16) glm::mat4 mMat;
     alignas(16) glm::mat4 nMat;
 };
@@ -66,6 +63,7 @@ struct GlobalUniformBufferObject {
     } lightOn[LIGHTS_COUNT];
     alignas(4) float cosIn;
     alignas(4) float cosOut;
+    alignas(16) glm::mat4 viewProjection;
 };
 
 struct Vertex {
@@ -9,17 +9,9 @@ const int LIGHTS_COUNT = 14;
 
 // LAYOUT BINDINGS AND LOCATIONS
 
-layout(binding = 0) uniform CookTorranceUniformBufferObject {
-    mat4 mvpMat; // Model-View-Projection matrix
-    mat4 mMat;   // Model matrix
-    mat4 nMat;   // Normal matrix (transpose(inverse(modelMatrix)))
-    float metalness;
-    float roughness;
-} ubo;
+layout(set = 1, binding = 1) uniform sampler2D texSampler;
 
-layout(binding = 1) uniform sampler2D texSampler;
-
-layout(binding = 2) uniform GlobalUniformBufferObject {
+layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
     vec3 ambientLightDir;
     vec4 ambientLightColor;
     vec3 lightDir[LIGHTS_COUNT];
@@ -30,11 +22,13 @@ layout(binding = 2) uniform GlobalUniformBufferObject {
     vec3 lightOn[LIGHTS_COUNT];
     float cosIn;
     float cosOut;
+    mat4 viewProjection;
 } gubo;
 
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragNorm;
 layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) flat in vec2 fragMaterial; // x = metalness, y = roughness (per instance)
 
 layout(location = 0) out vec4 outColor;
 
@@ -160,59 +154,59 @@ void main()
     
     LD = point_light_dir(fragPos, 0);
     LC = point_light_color(fragPos, 0);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[0];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[0];
     
     LD = point_light_dir(fragPos, 1);
     LC = point_light_color(fragPos, 1);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[1];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[1];
     
     LD = point_light_dir(fragPos, 2);
     LC = point_light_color(fragPos, 2);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[2];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[2];
     
     LD = point_light_dir(fragPos, 3);
     LC = point_light_color(fragPos, 3);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[3];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[3];
     
     LD = point_light_dir(fragPos, 4);
     LC = point_light_color(fragPos, 4);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[4];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[4];
     
     LD = point_light_dir(fragPos, 5);
     LC = point_light_color(fragPos, 5);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[5];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[5];
     
     LD = point_light_dir(fragPos, 6);
     LC = point_light_color(fragPos, 6);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[6];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[6];
     
     LD = point_light_dir(fragPos, 7);
     LC = point_light_color(fragPos, 7);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[7];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[7];
     
     LD = spot_light_dir(fragPos, 8);
     LC = spot_light_color(fragPos, 8);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[8];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[8];
     
     LD = spot_light_dir(fragPos, 9);
     LC = spot_light_color(fragPos, 9);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[9];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[9];
     
     LD = spot_light_dir(fragPos, 10);
     LC = spot_light_color(fragPos, 10);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[10];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[10];
     
     LD = spot_light_dir(fragPos, 11);
     LC = spot_light_color(fragPos, 11);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[11];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[11];
     
     LD = spot_light_dir(fragPos, 12);
     LC = spot_light_color(fragPos, 12);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[12];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[12];
     
     LD = spot_light_dir(fragPos, 13);
     LC = spot_light_color(fragPos, 13);
-    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, ubo.roughness, ubo.metalness) * LC * gubo.lightOn[13];
+    RendEqSol += BRDF(Albedo, Norm, EyeDir, LD, fragMaterial.y, fragMaterial.x) * LC * gubo.lightOn[13];
     
     outColor = vec4(RendEqSol, 1.0);
 }
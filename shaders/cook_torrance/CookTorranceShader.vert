@@ -5,6 +5,23 @@
 
 #version 450
 
+const int LIGHTS_COUNT = 14;
+
+// Global uniforms shared by every draw (same block as the fragment shader): only the view-projection is used here
+layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
+    vec3 ambientLightDir;
+    vec4 ambientLightColor;
+    vec3 lightDir[LIGHTS_COUNT];
+    vec3 lightPos[LIGHTS_COUNT];
+    vec4 lightColor[LIGHTS_COUNT];
+    vec3 eyePos;
+    vec4 eyeDir;
+    vec3 lightOn[LIGHTS_COUNT];
+    float cosIn;
+    float cosOut;
+    mat4 viewProjection;
+} gubo;
+
 // Input layout
 layout(location = 0) in vec3 inPosition;       // Vertice posizione
 layout(location = 1) in vec3 inNormal;         // Normale del vertice
@@ -14,20 +31,27 @@ layout(location = 2) in vec2 inTexCoord;       // Coordinate texture
 layout(location = 0) out vec3 fragPos;         // Posizione del frammento nello spazio del mondo
 layout(location = 1) out vec3 fragNorm;        // Normale interpolata
 layout(location = 2) out vec2 fragTexCoord;    // Coordinate texture interpolate
+layout(location = 3) flat out vec2 fragMaterial; // x = metalness, y = roughness
 
-// Uniforms
-layout(binding = 0, std140) uniform CookTorranceUniformBufferObject {
-    mat4 mvpMat; // Model-View-Projection matrix
+// Per-instance data, indexed by gl_InstanceIndex
+struct CookTorranceUniformBufferObject {
     mat4 mMat;   // Model matrix
     mat4 nMat;   // Normal matrix (transpose(inverse(modelMatrix)))
     float metalness;
     float roughness;
-} ubo;
+};
+
+layout(set = 1, binding = 0, std430) readonly buffer InstanceBuffer {
+    CookTorranceUniformBufferObject instances[];
+};
 
 void main()
 {
-    gl_Position = ubo.mvpMat * vec4(inPosition, 1.0);
-    fragPos = vec3(ubo.mMat * vec4(inPosition, 1.0));
+    CookTorranceUniformBufferObject ubo = instances[gl_InstanceIndex];
+    vec4 worldPos = ubo.mMat * vec4(inPosition, 1.0);
+    gl_Position = gubo.viewProjection * worldPos;
+    fragPos = vec3(worldPos);
     fragNorm = mat3(ubo.nMat) * inNormal;
     fragTexCoord = inTexCoord;
+    fragMaterial = vec2(ubo.metalness, ubo.roughness);
 }
@@ -9,16 +9,9 @@ const int LIGHTS_COUNT = 14;
 
 // LAYOUT BINDINGS AND LOCATIONS
 
-layout(binding = 0) uniform PhongUniformBufferObject
-{
-    mat4 mvpMat;
-    mat4 mMat;
-    mat4 nMat;
-} ubo;
-
-layout(binding = 1) uniform sampler2D texSampler;
+layout(set = 1, binding = 1) uniform sampler2D texSampler;
 
-layout(binding = 2) uniform GlobalUniformBufferObject {
+layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
     vec3 ambientLightDir;
     vec4 ambientLightColor;
     vec3 lightDir[LIGHTS_COUNT];
@@ -29,6 +22,7 @@ layout(binding = 2) uniform GlobalUniformBufferObject {
     vec3 lightOn[LIGHTS_COUNT];
     float cosIn;
     float cosOut;
+    mat4 viewProjection;
 } gubo;
 
 layout(location = 0) in vec3 fragPos;
@@ -5,12 +5,34 @@
 
 #version 450
 
-layout(binding = 0, std140) uniform PhongUniformBufferObject
+const int LIGHTS_COUNT = 14;
+
+// Global uniforms shared by every draw (same block as the fragment shader): only the view-projection is used here
+layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
+    vec3 ambientLightDir;
+    vec4 ambientLightColor;
+    vec3 lightDir[LIGHTS_COUNT];
+    vec3 lightPos[LIGHTS_COUNT];
+    vec4 lightColor[LIGHTS_COUNT];
+    vec3 eyePos;
+    vec4 eyeDir;
+    vec3 lightOn[LIGHTS_COUNT];
+    float cosIn;
+    float cosOut;
+    mat4 viewProjection;
+} gubo;
+
+// Per-instance data, indexed by gl_InstanceIndex
+struct PhongUniformBufferObject
 {
-    mat4 mvpMat;
     mat4 mMat;
     mat4 nMat;
-} ubo;
+};
+
+layout(set = 1, binding = 0, std430) readonly buffer InstanceBuffer
+{
+    PhongUniformBufferObject instances[];
+};
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -22,8 +44,10 @@ layout(location = 2) out vec2 fragTexCoord;
 
 void main()
 {
-    gl_Position = ubo.mvpMat * vec4(inPosition, 1.0);
-    fragPos = (ubo.mMat * vec4(inPosition, 1.0)).xyz;
+    PhongUniformBufferObject ubo = instances[gl_InstanceIndex];
+    vec4 worldPos = ubo.mMat * vec4(inPosition, 1.0);
+    gl_Position = gubo.viewProjection * worldPos;
+    fragPos = worldPos.xyz;
     fragNorm = mat3(ubo.nMat) * inNormal;
     fragTexCoord = inTexCoord;
 }
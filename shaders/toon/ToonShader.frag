@@ -6,19 +6,11 @@ const int LIGHTS_COUNT = 14;
 
 // LAYOUT BINDINGS AND LOCATIONS
 
-// Uniform Buffer Object (UBO) per Toon shading
-layout(binding = 0) uniform ToonUniformBufferObject
-{
-    mat4 mvpMat;  // Matrice Model-View-Projection
-    mat4 mMat;    // Matrice Model
-    mat4 nMat;    // Matrice Normale (trasposta e inversa della matrice model)
-} ubo;
-
 // Sampler per la texture
-layout(binding = 1) uniform sampler2D texSampler;
+layout(set = 1, binding = 1) uniform sampler2D texSampler;
 
 // Global Uniform Buffer Object che contiene informazioni sulla luce
-layout(binding = 2) uniform GlobalUniformBufferObject {
+layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
     vec3 ambientLightDir;
     vec4 ambientLightColor;
     vec3 lightDir[LIGHTS_COUNT];
@@ -29,6 +21,7 @@ layout(binding = 2) uniform GlobalUniformBufferObject {
     vec3 lightOn[LIGHTS_COUNT];
     float cosIn;
     float cosOut;
+    mat4 viewProjection;
 } gubo;
 
 // Variabili di input per la posizione, normale e coordinate texture
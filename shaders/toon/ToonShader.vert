@@ -2,13 +2,34 @@
 
 #version 450
 
-// Uniform Buffer Object (UBO) per Toon shading
-layout(binding = 0, std140) uniform ToonUniformBufferObject
+const int LIGHTS_COUNT = 14;
+
+// Global uniforms shared by every draw (same block as the fragment shader): only the view-projection is used here
+layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
+    vec3 ambientLightDir;
+    vec4 ambientLightColor;
+    vec3 lightDir[LIGHTS_COUNT];
+    vec3 lightPos[LIGHTS_COUNT];
+    vec4 lightColor[LIGHTS_COUNT];
+    vec3 eyePos;
+    vec4 eyeDir;
+    vec3 lightOn[LIGHTS_COUNT];
+    float cosIn;
+    float cosOut;
+    mat4 viewProjection;
+} gubo;
+
+// Dati per istanza, indicizzati con gl_InstanceIndex
+struct ToonUniformBufferObject
 {
-    mat4 mvpMat;  // Matrize Model-View-Projection
     mat4 mMat;    // Matrize Model
     mat4 nMat;    // Matrize Normal (trasposta e inversa della matrice model)
-} ubo;
+};
+
+layout(set = 1, binding = 0, std430) readonly buffer InstanceBuffer
+{
+    ToonUniformBufferObject instances[];
+};
 
 // Attributi degli input (dati dal vertex)
 layout(location = 0) in vec3 inPosition;  // Posizione del vertice
@@ -21,8 +42,10 @@ layout(location = 1) out vec3 fragNorm;   // Normale del frammento
 layout(location = 2) out vec2 fragTexCoord; // Coordinate texture per il frammento
 
 void main() {
-    gl_Position = ubo.mvpMat * vec4(inPosition, 1.0);
-    fragPos = vec3(ubo.mMat * vec4(inPosition, 1.0));
+    ToonUniformBufferObject ubo = instances[gl_InstanceIndex];
+    vec4 worldPos = ubo.mMat * vec4(inPosition, 1.0);
+    gl_Position = gubo.viewProjection * worldPos;
+    fragPos = vec3(worldPos);
     fragNorm = mat3(ubo.nMat) * inNormal;
     fragTexCoord = inTexCoord;
 }